@@ -0,0 +1,989 @@
+/**
+ * Accumulator.c
+ * @author Simon Collignon
+ *
+ * Records are folded into cycle bins of acc->length samples as they arrive.
+ * Raw codes are summed in 32 bit bins which are flushed into 64 bit bins
+ * before they can overflow, so the sums stay exact whatever the number of
+ * averages. The scale and zero of the raw format are applied once, when the
+ * mean is read.
+ *
+ * Volts are summed in float, which keeps the hot loop as narrow as the data,
+ * and moved into double sums every few cycles: a float sum of a million
+ * cycles would have lost the last bits of every sample it added, a float sum
+ * of 64 cycles loses far less than the ADC resolution.
+ *
+ * The variance comes from the sums of the squared samples, added by the same
+ * kernels as the sums while the samples are in registers, so the records
+ * are still read once. The squares are doubles, exact for raw codes, and
+ * sums and squares of several threads or blocks combine by plain addition.
+ *
+ * For the cycle lengths we use most the fold is also compiled with the length
+ * as a constant: whole cycles then run a fixed trip count loop the compiler
+ * vectorizes without remainder handling, and the bin of the first sample is a
+ * multiplication instead of a division.
+ *
+ * The hot loops run the vectorized kernels of Kernels.c, the scalar ones
+ * below only serve the raw types our scopes don't use.
+ */
+
+#include "Accumulator.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Parallel.h"
+#include "Utils.h" // for NEWLINE
+
+// sum[i] += src[i], widening the source type to the sum type:
+#define DEFINE_ACCUMULATE(name, sumType, srcType) \
+  static void name(sumType* restrict sum, const srcType* restrict src, uint64_t count) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      sum[i] += src[i]; \
+    } \
+  }
+
+DEFINE_ACCUMULATE(accumulateUInt8To32, int32_t, uint8_t)
+DEFINE_ACCUMULATE(accumulateUInt16To32, int32_t, uint16_t)
+DEFINE_ACCUMULATE(accumulateInt8To64, int64_t, int8_t)
+DEFINE_ACCUMULATE(accumulateUInt8To64, int64_t, uint8_t)
+DEFINE_ACCUMULATE(accumulateInt16To64, int64_t, int16_t)
+DEFINE_ACCUMULATE(accumulateUInt16To64, int64_t, uint16_t)
+DEFINE_ACCUMULATE(accumulateUInt32To64, int64_t, uint32_t)
+DEFINE_ACCUMULATE(accumulateInt64To64, int64_t, int64_t)
+DEFINE_ACCUMULATE(accumulateDoubleToDouble, double, double)
+
+// squares[i] += src[i]^2, for the raw types without a vectorized kernel and
+// the window squares:
+#define DEFINE_ACCUMULATE_SQUARES(name, srcType) \
+  static void name(double* restrict squares, const srcType* restrict src, uint64_t count) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      squares[i] += (double) src[i] * src[i]; \
+    } \
+  }
+
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresInt8, int8_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresUInt8, uint8_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresInt16, int16_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresUInt16, uint16_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresInt32, int32_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresUInt32, uint32_t)
+DEFINE_ACCUMULATE_SQUARES(accumulateSquaresFloat, float)
+
+// sum[i] -= src[i] and squares[i] -= src[i]^2 unless squares is NULL, takes
+// a rejected cycle of raw codes back out, exactly:
+#define DEFINE_SUBTRACT(name, sumType, srcType) \
+  static void name(sumType* restrict sum, double* restrict squares, const srcType* restrict src, uint64_t count) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      sum[i] -= src[i]; \
+    } \
+    for(uint64_t i = 0; squares && i < count; i++) \
+    { \
+      squares[i] -= (double) src[i] * src[i]; \
+    } \
+  }
+
+DEFINE_SUBTRACT(subtractInt8To32, int32_t, int8_t)
+DEFINE_SUBTRACT(subtractInt16To32, int32_t, int16_t)
+
+// sums[ch][(position + i) % LENGTH] += data[ch][i] for a compile time LENGTH,
+// add is the kernel adding srcType to the 32 bit sums, addSquares the one
+// also adding the squares. The channels are walked together, one cycle at a
+// time, so a chunk is read in a single pass:
+#define DEFINE_FOLD(name, srcType, LENGTH, add, addSquares) \
+  static void name(const Kernels_t* kernels, int32_t** sums, double** squares, void** data, uint16_t channelCount, uint64_t position, uint64_t count) \
+  { \
+    uint64_t bin = position % (LENGTH); \
+    uint64_t i = 0; \
+    while(i < count) \
+    { \
+      uint64_t n = (LENGTH) - bin < count - i ? (LENGTH) - bin : count - i; \
+      for(uint16_t ch = 0; ch < channelCount; ch++) \
+      { \
+        if(squares) \
+          kernels->addSquares(sums[ch] + bin, squares[ch] + bin, (const srcType*) data[ch] + i, n); \
+        else \
+          kernels->add(sums[ch] + bin, (const srcType*) data[ch] + i, n); \
+      } \
+      i += n; \
+      bin = 0; \
+    } \
+  }
+
+// FID cycles of the averaging and hybrid settings, and whole block records:
+DEFINE_FOLD(foldInt8Length10k, int8_t, 10000, addInt8To32, addSquaresInt8To32)
+DEFINE_FOLD(foldInt16Length10k, int16_t, 10000, addInt16To32, addSquaresInt16To32)
+DEFINE_FOLD(foldInt8Length5M, int8_t, 5000000, addInt8To32, addSquaresInt8To32)
+DEFINE_FOLD(foldInt16Length5M, int16_t, 5000000, addInt16To32, addSquaresInt16To32)
+DEFINE_FOLD(foldInt8Length50M, int8_t, 50000000, addInt8To32, addSquaresInt8To32)
+DEFINE_FOLD(foldInt16Length50M, int16_t, 50000000, addInt16To32, addSquaresInt16To32)
+
+static const struct
+{
+  uint64_t length;
+  uint32_t type;
+  FoldKernel_t kernel;
+} FoldKernels[] = {
+  {10000, DATARAWTYPE_INT8, foldInt8Length10k},
+  {10000, DATARAWTYPE_INT16, foldInt16Length10k},
+  {5000000, DATARAWTYPE_INT8, foldInt8Length5M},
+  {5000000, DATARAWTYPE_INT16, foldInt16Length5M},
+  {50000000, DATARAWTYPE_INT8, foldInt8Length50M},
+  {50000000, DATARAWTYPE_INT16, foldInt16Length50M}
+};
+
+static FoldKernel_t foldKernelFind(uint64_t length, uint32_t type)
+{
+  for(size_t k = 0; k < sizeof(FoldKernels) / sizeof(FoldKernels[0]); k++)
+  {
+    if(FoldKernels[k].length == length && FoldKernels[k].type == type)
+      return FoldKernels[k].kernel;
+  }
+
+  return NULL;
+}
+
+static void accumulateSquaresRaw(double* squares, const void* src, uint32_t type, uint64_t count)
+{
+  switch(type)
+  {
+    case DATARAWTYPE_INT8:   accumulateSquaresInt8(squares, src, count); break;
+    case DATARAWTYPE_UINT8:  accumulateSquaresUInt8(squares, src, count); break;
+    case DATARAWTYPE_INT16:  accumulateSquaresInt16(squares, src, count); break;
+    case DATARAWTYPE_UINT16: accumulateSquaresUInt16(squares, src, count); break;
+    case DATARAWTYPE_INT32:  accumulateSquaresInt32(squares, src, count); break;
+    case DATARAWTYPE_UINT32: accumulateSquaresUInt32(squares, src, count); break;
+  }
+}
+
+// The squares are added too unless squares is NULL:
+static void accumulateRawTo32(const Kernels_t* kernels, int32_t* sum, double* squares, const void* src, uint32_t type, uint64_t count)
+{
+  if(squares && type == DATARAWTYPE_INT8)
+  {
+    kernels->addSquaresInt8To32(sum, squares, src, count);
+    return;
+  }
+
+  if(squares && type == DATARAWTYPE_INT16)
+  {
+    kernels->addSquaresInt16To32(sum, squares, src, count);
+    return;
+  }
+
+  switch(type)
+  {
+    case DATARAWTYPE_INT8:   kernels->addInt8To32(sum, src, count); break;
+    case DATARAWTYPE_UINT8:  accumulateUInt8To32(sum, src, count); break;
+    case DATARAWTYPE_INT16:  kernels->addInt16To32(sum, src, count); break;
+    case DATARAWTYPE_UINT16: accumulateUInt16To32(sum, src, count); break;
+  }
+
+  if(squares)
+    accumulateSquaresRaw(squares, src, type, count);
+}
+
+static void accumulateRawTo64(const Kernels_t* kernels, int64_t* sum, double* squares, const void* src, uint32_t type, uint64_t count)
+{
+  if(squares)
+    accumulateSquaresRaw(squares, src, type, count);
+
+  switch(type)
+  {
+    case DATARAWTYPE_INT8:   accumulateInt8To64(sum, src, count); break;
+    case DATARAWTYPE_UINT8:  accumulateUInt8To64(sum, src, count); break;
+    case DATARAWTYPE_INT16:  accumulateInt16To64(sum, src, count); break;
+    case DATARAWTYPE_UINT16: accumulateUInt16To64(sum, src, count); break;
+    case DATARAWTYPE_INT32:  kernels->addInt32To64(sum, src, count); break;
+    case DATARAWTYPE_UINT32: accumulateUInt32To64(sum, src, count); break;
+  }
+}
+
+size_t rawSampleSize(uint32_t type)
+{
+  switch(type)
+  {
+    case DATARAWTYPE_INT8:
+    case DATARAWTYPE_UINT8:
+      return 1;
+    case DATARAWTYPE_INT16:
+    case DATARAWTYPE_UINT16:
+      return 2;
+    case DATARAWTYPE_INT32:
+    case DATARAWTYPE_UINT32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+bool8_t rawFormatGet(LibTiePieHandle_t scp, uint16_t ch, RawFormat_t* format)
+{
+  format->type = ScpChGetDataRawType(scp, ch);
+  ScpChGetDataRawValueRange(scp, ch, &format->min, &format->zero, &format->max);
+
+  double min, max;
+  ScpChGetDataValueRange(scp, ch, &min, &max);
+
+  if(LibGetLastStatus() < LIBTIEPIESTATUS_SUCCESS || rawSampleSize(format->type) == 0 || format->max <= format->min)
+  {
+    fprintf(stderr, "Unsupported raw data type 0x%08x on Ch%d" NEWLINE, (unsigned) format->type, ch + 1);
+    return BOOL8_FALSE;
+  }
+
+  format->scale = (max - min) / (format->max - format->min);
+  return BOOL8_TRUE;
+}
+
+static int64_t rawFormatMaxAbs(const RawFormat_t* format)
+{
+  return llabs(format->min) > llabs(format->max) ? llabs(format->min) : llabs(format->max);
+}
+
+// Allocate zeroed buffers of length samples for every channel, in one block.
+// Separate large allocations all start at the same offset in a page, so the
+// same bin of every channel would compete for the same cache sets; here each
+// channel starts one cache line further into its page than the previous one:
+static void** allocChannels(uint16_t channelCount, uint64_t length, size_t size)
+{
+  size_t stride = (length * size + 63) / 64 * 64 + 64;
+  void** buffers = calloc(channelCount, sizeof(void*));
+  char* block = buffers ? calloc(channelCount, stride) : NULL;
+
+  if(!block)
+  {
+    free(buffers);
+    return NULL;
+  }
+
+  for(uint16_t ch = 0; ch < channelCount; ch++)
+  {
+    buffers[ch] = block + ch * stride;
+  }
+
+  return buffers;
+}
+
+static void freeChannels(void** buffers, uint16_t channelCount)
+{
+  if(buffers && channelCount > 0)
+    free(buffers[0]);
+
+  free(buffers);
+}
+
+bool8_t accumulatorInit(Accumulator_t* acc, LibTiePieHandle_t scp, uint16_t channelCount, uint64_t length, bool8_t raw, uint64_t maxCount, uint64_t floatFlushInterval)
+{
+  acc->channelCount = channelCount;
+  acc->length = length;
+  acc->raw = raw;
+  acc->formats = NULL;
+  acc->data = NULL;
+  acc->sumDouble = NULL;
+  acc->sum32 = NULL;
+  acc->sum64 = NULL;
+  acc->sumSquares = NULL;
+  acc->blockMeans = NULL;
+  acc->blockM2 = NULL;
+  acc->blockStart = NULL;
+  acc->windowSquares = NULL;
+  acc->windowStart = 0;
+  acc->windowLength = 0;
+  acc->limits = NULL;
+  acc->saturatedCount = 0;
+  acc->glitchCount = 0;
+  acc->blockCount = 0;
+  acc->blockStartCount = 0;
+  acc->count = 0;
+  acc->pending = 0;
+  acc->flushInterval = UINT64_MAX;
+  acc->fold = NULL;
+  acc->kernels = kernels();
+
+  if(!raw)
+  {
+    acc->data = (float**) allocChannels(channelCount, length, sizeof(float));
+
+    if(floatFlushInterval > 0 && maxCount > floatFlushInterval)
+    {
+      acc->flushInterval = floatFlushInterval;
+      acc->sumDouble = (double**) allocChannels(channelCount, length, sizeof(double));
+    }
+
+    if(!acc->data || (acc->flushInterval != UINT64_MAX && !acc->sumDouble))
+    {
+      accumulatorFree(acc);
+      return BOOL8_FALSE;
+    }
+
+    return BOOL8_TRUE;
+  }
+
+  acc->formats = malloc(sizeof(RawFormat_t) * channelCount);
+  if(!acc->formats)
+  {
+    accumulatorFree(acc);
+    return BOOL8_FALSE;
+  }
+
+  // 32 bit sums halve the memory traffic, as long as they are flushed into
+  // the 64 bit sums before they can overflow:
+  bool8_t narrow = BOOL8_TRUE;
+  for(uint16_t ch = 0; ch < channelCount; ch++)
+  {
+    if(!rawFormatGet(scp, ch, &acc->formats[ch]))
+    {
+      accumulatorFree(acc);
+      return BOOL8_FALSE;
+    }
+
+    if(acc->formats[ch].type & (DATARAWTYPE_INT32 | DATARAWTYPE_UINT32))
+    {
+      narrow = BOOL8_FALSE;
+    }
+    else
+    {
+      uint64_t interval = INT32_MAX / rawFormatMaxAbs(&acc->formats[ch]);
+      if(interval < acc->flushInterval)
+        acc->flushInterval = interval;
+    }
+  }
+
+  if(narrow)
+  {
+    acc->sum32 = (int32_t**) allocChannels(channelCount, length, sizeof(int32_t));
+    if(!acc->sum32)
+    {
+      accumulatorFree(acc);
+      return BOOL8_FALSE;
+    }
+
+    // One kernel serves all channels, so they must share the raw type:
+    acc->fold = foldKernelFind(length, acc->formats[0].type);
+    for(uint16_t ch = 1; ch < channelCount; ch++)
+    {
+      if(acc->formats[ch].type != acc->formats[0].type)
+        acc->fold = NULL;
+    }
+  }
+
+  if(!narrow || maxCount > acc->flushInterval)
+  {
+    acc->sum64 = (int64_t**) allocChannels(channelCount, length, sizeof(int64_t));
+    if(!acc->sum64)
+    {
+      accumulatorFree(acc);
+      return BOOL8_FALSE;
+    }
+  }
+
+  return BOOL8_TRUE;
+}
+
+bool8_t accumulatorEnableVariance(Accumulator_t* acc, bool8_t blocks)
+{
+  acc->sumSquares = (double**) allocChannels(acc->channelCount, acc->length, sizeof(double));
+
+  if(blocks)
+  {
+    acc->blockMeans = (double**) allocChannels(acc->channelCount, acc->length, sizeof(double));
+    acc->blockM2 = (double**) allocChannels(acc->channelCount, acc->length, sizeof(double));
+    acc->blockStart = (double**) allocChannels(acc->channelCount, acc->length, sizeof(double));
+  }
+
+  return acc->sumSquares && (!blocks || (acc->blockMeans && acc->blockM2 && acc->blockStart));
+}
+
+bool8_t accumulatorEnableWindowSquares(Accumulator_t* acc, uint64_t start, uint64_t length)
+{
+  if(length == 0 || start + length > acc->length)
+    return BOOL8_FALSE;
+
+  if(acc->sumSquares)
+    return BOOL8_TRUE;
+
+  acc->windowSquares = (double**) allocChannels(acc->channelCount, length, sizeof(double));
+  acc->windowStart = start;
+  acc->windowLength = length;
+
+  return acc->windowSquares != NULL;
+}
+
+bool8_t accumulatorEnableRejection(Accumulator_t* acc, LibTiePieHandle_t scp, double level, double step)
+{
+  acc->limits = malloc(sizeof(double) * ACCUMULATOR_LIMIT_COUNT * acc->channelCount);
+  if(!acc->limits)
+    return BOOL8_FALSE;
+
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    double* limits = acc->limits + ch * ACCUMULATOR_LIMIT_COUNT;
+    RawFormat_t format;
+
+    if(acc->raw)
+      format = acc->formats[ch];
+    else if(!rawFormatGet(scp, ch, &format))
+      return BOOL8_FALSE;
+
+    if(acc->raw && format.type != DATARAWTYPE_INT8 && format.type != DATARAWTYPE_INT16)
+    {
+      fprintf(stderr, "No rejection for raw data type 0x%08x on Ch%d" NEWLINE, (unsigned) format.type, ch + 1);
+      return BOOL8_FALSE;
+    }
+
+    // Codes, or volts half a code inside the extreme codes so the float
+    // rounding of a sample on the rails can't miss them:
+    if(acc->raw)
+    {
+      limits[ACCUMULATOR_LIMIT_RAIL_LOW] = format.min;
+      limits[ACCUMULATOR_LIMIT_RAIL_HIGH] = format.max;
+      limits[ACCUMULATOR_LIMIT_LEVEL_LOW] = level > 0 ? format.zero - level / format.scale : format.min;
+      limits[ACCUMULATOR_LIMIT_LEVEL_HIGH] = level > 0 ? format.zero + level / format.scale : format.max;
+      limits[ACCUMULATOR_LIMIT_STEP] = step / format.scale;
+    }
+    else
+    {
+      limits[ACCUMULATOR_LIMIT_RAIL_LOW] = (format.min - format.zero + 0.5) * format.scale;
+      limits[ACCUMULATOR_LIMIT_RAIL_HIGH] = (format.max - format.zero - 0.5) * format.scale;
+      limits[ACCUMULATOR_LIMIT_LEVEL_LOW] = level > 0 ? -level : limits[ACCUMULATOR_LIMIT_RAIL_LOW];
+      limits[ACCUMULATOR_LIMIT_LEVEL_HIGH] = level > 0 ? level : limits[ACCUMULATOR_LIMIT_RAIL_HIGH];
+      limits[ACCUMULATOR_LIMIT_STEP] = step;
+    }
+  }
+
+  // The specialized folds have no check:
+  acc->fold = NULL;
+  return BOOL8_TRUE;
+}
+
+// Sum of sample i of channel ch, in raw codes or volts:
+static double accumulatorSum(const Accumulator_t* acc, uint16_t ch, uint64_t i)
+{
+  if(!acc->raw)
+    return acc->data[ch][i] + (acc->sumDouble ? acc->sumDouble[ch][i] : 0);
+
+  return (double) ((acc->sum32 ? acc->sum32[ch][i] : 0) + (acc->sum64 ? acc->sum64[ch][i] : 0));
+}
+
+void accumulatorEndBlock(Accumulator_t* acc)
+{
+  uint64_t cycles = acc->count - acc->blockStartCount;
+
+  if(!acc->blockMeans || cycles == 0)
+    return;
+
+  // Welford's update of the mean and the squared deviations of the block
+  // means, the block means are too close to each other for their sum of
+  // squares:
+  uint64_t n = acc->blockCount + 1;
+
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    for(uint64_t i = 0; i < acc->length; i++)
+    {
+      double sum = accumulatorSum(acc, ch, i);
+      double mean = (sum - acc->blockStart[ch][i]) / cycles;
+      double delta = mean - acc->blockMeans[ch][i];
+      acc->blockMeans[ch][i] += delta / n;
+      acc->blockM2[ch][i] += delta * (mean - acc->blockMeans[ch][i]);
+      acc->blockStart[ch][i] = sum;
+    }
+  }
+
+  acc->blockCount++;
+  acc->blockStartCount = acc->count;
+}
+
+// Move the 32 bit sums into the 64 bit sums, or the float sums into the double sums:
+static void accumulatorFlush(Accumulator_t* acc)
+{
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    if(acc->raw)
+    {
+      acc->kernels->addInt32To64(acc->sum64[ch], acc->sum32[ch], acc->length);
+      memset(acc->sum32[ch], 0, sizeof(int32_t) * acc->length);
+    }
+    else
+    {
+      acc->kernels->addFloatToDouble(acc->sumDouble[ch], acc->data[ch], acc->length);
+      memset(acc->data[ch], 0, sizeof(float) * acc->length);
+    }
+  }
+
+  acc->pending = 0;
+}
+
+// What a cycle of range[ch] (smallest and largest sample, largest step) is
+// rejected for, if anything:
+typedef enum
+{
+  REJECT_NONE,
+  REJECT_SATURATED,
+  REJECT_GLITCH
+} Reject_t;
+
+static Reject_t accumulatorClassify(const Accumulator_t* acc, double ranges[][3])
+{
+  Reject_t reject = REJECT_NONE;
+
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    const double* limits = acc->limits + ch * ACCUMULATOR_LIMIT_COUNT;
+    const double* range = ranges[ch];
+
+    if(range[0] <= limits[ACCUMULATOR_LIMIT_RAIL_LOW] || range[1] >= limits[ACCUMULATOR_LIMIT_RAIL_HIGH])
+      return REJECT_SATURATED;
+
+    if(range[0] <= limits[ACCUMULATOR_LIMIT_LEVEL_LOW] || range[1] >= limits[ACCUMULATOR_LIMIT_LEVEL_HIGH] ||
+      (limits[ACCUMULATOR_LIMIT_STEP] > 0 && range[2] > limits[ACCUMULATOR_LIMIT_STEP]))
+      reject = REJECT_GLITCH;
+  }
+
+  return reject;
+}
+
+// Add the squares of samples [start, end) of data, at position in the
+// record, that fall in the window. The sums are added by then:
+static void accumulatorAddWindowSquares(Accumulator_t* acc, void** data, uint64_t position, uint64_t start, uint64_t end)
+{
+  uint64_t i = start;
+
+  while(i < end)
+  {
+    uint64_t bin = (position + i) % acc->length;
+    uint64_t n = acc->length - bin < end - i ? acc->length - bin : end - i;
+    uint64_t first = bin > acc->windowStart ? bin : acc->windowStart;
+    uint64_t last = bin + n < acc->windowStart + acc->windowLength ? bin + n : acc->windowStart + acc->windowLength;
+
+    for(uint16_t ch = 0; first < last && ch < acc->channelCount; ch++)
+    {
+      double* squares = acc->windowSquares[ch] + first - acc->windowStart;
+      uint64_t j = i + first - bin; // in data
+
+      if(!acc->raw)
+        accumulateSquaresFloat(squares, (float*) data[ch] + j, last - first);
+      else
+        accumulateSquaresRaw(squares, (char*) data[ch] + j * rawSampleSize(acc->formats[ch].type), acc->formats[ch].type, last - first);
+    }
+
+    i += n;
+  }
+}
+
+// accumulatorAdd with the samples checked by the same kernels that add them,
+// whole cycles of raw codes failing the check are subtracted again right
+// away, while they are still in cache. Whole cycles in volts are checked
+// while they are in cache and only added when they pass:
+static void accumulatorAddChecked(Accumulator_t* acc, void** data, uint64_t position, uint64_t count)
+{
+  double ranges[acc->channelCount][3];
+  uint64_t i = 0;
+
+  while(i < count)
+  {
+    uint64_t bin = (position + i) % acc->length;
+    uint64_t n = acc->length - bin < count - i ? acc->length - bin : count - i;
+
+    if(acc->sum32 && acc->sum64 && acc->pending + 2 > acc->flushInterval)
+      accumulatorFlush(acc);
+    else if(acc->sumDouble && acc->pending >= acc->flushInterval)
+      accumulatorFlush(acc);
+
+    // Only cycles entirely in this call can be rejected:
+    bool8_t whole = bin == 0 && n == acc->length;
+    bool8_t checkFirst = whole && !acc->raw;
+
+    for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+    {
+      double* squares = acc->sumSquares ? acc->sumSquares[ch] + bin : NULL;
+
+      if(!acc->raw)
+      {
+        float range[3] = {INFINITY, -INFINITY, 0};
+        if(checkFirst)
+          acc->kernels->checkFloat((float*) data[ch] + i, n, range);
+        else if(squares)
+          acc->kernels->addSquaresFloat(acc->data[ch] + bin, squares, (float*) data[ch] + i, n);
+        else
+          acc->kernels->addFloat(acc->data[ch] + bin, (float*) data[ch] + i, n);
+        ranges[ch][0] = range[0];
+        ranges[ch][1] = range[1];
+        ranges[ch][2] = range[2];
+      }
+      else
+      {
+        int32_t range[3] = {INT32_MAX, INT32_MIN, 0};
+        if(acc->formats[ch].type == DATARAWTYPE_INT8)
+          acc->kernels->addCheckInt8To32(acc->sum32[ch] + bin, squares, (int8_t*) data[ch] + i, n, range);
+        else
+          acc->kernels->addCheckInt16To32(acc->sum32[ch] + bin, squares, (int16_t*) data[ch] + i, n, range);
+        ranges[ch][0] = range[0];
+        ranges[ch][1] = range[1];
+        ranges[ch][2] = range[2];
+      }
+    }
+
+    Reject_t reject = whole ? accumulatorClassify(acc, ranges) : REJECT_NONE;
+
+    for(uint16_t ch = 0; checkFirst && reject == REJECT_NONE && ch < acc->channelCount; ch++)
+    {
+      if(acc->sumSquares)
+        acc->kernels->addSquaresFloat(acc->data[ch], acc->sumSquares[ch], (float*) data[ch] + i, n);
+      else
+        acc->kernels->addFloat(acc->data[ch], (float*) data[ch] + i, n);
+    }
+
+    if(reject != REJECT_NONE)
+    {
+      for(uint16_t ch = 0; acc->raw && ch < acc->channelCount; ch++)
+      {
+        double* squares = acc->sumSquares ? acc->sumSquares[ch] : NULL;
+
+        if(acc->formats[ch].type == DATARAWTYPE_INT8)
+          subtractInt8To32(acc->sum32[ch], squares, (int8_t*) data[ch] + i, n);
+        else
+          subtractInt16To32(acc->sum32[ch], squares, (int16_t*) data[ch] + i, n);
+      }
+
+      if(reject == REJECT_SATURATED)
+        acc->saturatedCount++;
+      else
+        acc->glitchCount++;
+    }
+    else if(bin + n == acc->length)
+    {
+      acc->pending++;
+      acc->count++;
+    }
+
+    if(reject == REJECT_NONE && acc->windowSquares)
+      accumulatorAddWindowSquares(acc, data, position, i, i + n);
+
+    i += n;
+  }
+}
+
+void accumulatorAdd(Accumulator_t* acc, void** data, uint64_t position, uint64_t count)
+{
+  if(acc->limits)
+  {
+    accumulatorAddChecked(acc, data, position, count);
+    return;
+  }
+
+  // Cycles whose last sample is in this call:
+  uint64_t cycles = (position + count) / acc->length - position / acc->length;
+
+  // A specialized kernel folds the whole call at once, so sum32 must hold all
+  // of it, including the started cycles at both ends:
+  if(acc->fold && acc->sum64 && acc->pending + cycles + 2 > acc->flushInterval)
+    accumulatorFlush(acc);
+
+  if(acc->fold && (!acc->sum64 || acc->pending + cycles + 2 <= acc->flushInterval))
+  {
+    acc->fold(acc->kernels, acc->sum32, acc->sumSquares, data, acc->channelCount, position, count);
+
+    if(acc->windowSquares)
+      accumulatorAddWindowSquares(acc, data, position, 0, count);
+
+    acc->pending += cycles;
+    acc->count += cycles;
+    return;
+  }
+
+  uint64_t i = 0;
+
+  while(i < count)
+  {
+    // Add up to the end of the current cycle:
+    uint64_t bin = (position + i) % acc->length;
+    uint64_t n = acc->length - bin < count - i ? acc->length - bin : count - i;
+
+    // A started cycle adds one more to some bins than pending tells:
+    if(acc->sum32 && acc->sum64 && acc->pending + 2 > acc->flushInterval)
+      accumulatorFlush(acc);
+    else if(acc->sumDouble && acc->pending >= acc->flushInterval)
+      accumulatorFlush(acc);
+
+    for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+    {
+      double* squares = acc->sumSquares ? acc->sumSquares[ch] + bin : NULL;
+
+      if(!acc->raw && squares)
+        acc->kernels->addSquaresFloat(acc->data[ch] + bin, squares, (float*) data[ch] + i, n);
+      else if(!acc->raw)
+        acc->kernels->addFloat(acc->data[ch] + bin, (float*) data[ch] + i, n);
+      else if(acc->sum32)
+        accumulateRawTo32(acc->kernels, acc->sum32[ch] + bin, squares, (char*) data[ch] + i * rawSampleSize(acc->formats[ch].type), acc->formats[ch].type, n);
+      else
+        accumulateRawTo64(acc->kernels, acc->sum64[ch] + bin, squares, (char*) data[ch] + i * rawSampleSize(acc->formats[ch].type), acc->formats[ch].type, n);
+    }
+
+    if(bin + n == acc->length)
+    {
+      acc->pending++;
+      acc->count++;
+    }
+
+    i += n;
+  }
+
+  if(acc->windowSquares)
+    accumulatorAddWindowSquares(acc, data, position, 0, count);
+}
+
+// Add cycles [firstCycle, lastCycle) of src to dst, only bins [firstBin, lastBin):
+static void accumulatorFoldRange(Accumulator_t* dst, const Accumulator_t* src, uint64_t firstCycle, uint64_t lastCycle, uint64_t firstBin, uint64_t lastBin)
+{
+  uint64_t n = lastBin - firstBin;
+
+  for(uint16_t ch = 0; ch < dst->channelCount; ch++)
+  {
+    for(uint64_t c = firstCycle; c < lastCycle; c++)
+    {
+      uint64_t i = c * dst->length + firstBin;
+
+      if(src->sumSquares && dst->sumSquares)
+        accumulateDoubleToDouble(dst->sumSquares[ch] + firstBin, src->sumSquares[ch] + i, n);
+
+      if(!dst->raw)
+      {
+        // The record sums already hold many blocks, so they go straight into
+        // the double sums when there are some:
+        if(dst->sumDouble)
+          dst->kernels->addFloatToDouble(dst->sumDouble[ch] + firstBin, src->data[ch] + i, n);
+        else
+          dst->kernels->addFloat(dst->data[ch] + firstBin, src->data[ch] + i, n);
+
+        if(src->sumDouble && dst->sumDouble)
+          accumulateDoubleToDouble(dst->sumDouble[ch] + firstBin, src->sumDouble[ch] + i, n);
+        continue;
+      }
+
+      // The sums of src are added in one go, straight into the widest sums of dst:
+      if(src->sum32 && dst->sum64)
+        dst->kernels->addInt32To64(dst->sum64[ch] + firstBin, src->sum32[ch] + i, n);
+      else if(src->sum32)
+        dst->kernels->addInt32To32(dst->sum32[ch] + firstBin, src->sum32[ch] + i, n);
+
+      if(src->sum64)
+        accumulateInt64To64(dst->sum64[ch] + firstBin, src->sum64[ch] + i, n);
+    }
+  }
+}
+
+// Zeroed sums of the same kind and length as like, without the raw formats:
+static bool8_t accumulatorInitLike(Accumulator_t* acc, const Accumulator_t* like)
+{
+  *acc = *like;
+  acc->formats = NULL;
+  acc->data = like->data ? (float**) allocChannels(like->channelCount, like->length, sizeof(float)) : NULL;
+  acc->sumDouble = like->sumDouble ? (double**) allocChannels(like->channelCount, like->length, sizeof(double)) : NULL;
+  acc->sumSquares = like->sumSquares ? (double**) allocChannels(like->channelCount, like->length, sizeof(double)) : NULL;
+  acc->blockMeans = NULL;
+  acc->blockM2 = NULL;
+  acc->blockStart = NULL;
+  acc->windowSquares = NULL;
+  acc->limits = NULL;
+  acc->sum32 = like->sum32 ? (int32_t**) allocChannels(like->channelCount, like->length, sizeof(int32_t)) : NULL;
+  acc->sum64 = like->sum64 ? (int64_t**) allocChannels(like->channelCount, like->length, sizeof(int64_t)) : NULL;
+
+  if((like->data && !acc->data) || (like->sumDouble && !acc->sumDouble) || (like->sumSquares && !acc->sumSquares) || (like->sum32 && !acc->sum32) || (like->sum64 && !acc->sum64))
+  {
+    accumulatorFree(acc);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+typedef struct
+{
+  Accumulator_t* dst;
+  const Accumulator_t* src;
+  Accumulator_t* partials; // one per thread, partials[0] is dst itself, NULL when split by bins
+  unsigned threadCount;
+  uint64_t cycleCount;
+} FoldJob_t;
+
+static void accumulatorFoldTask(void* arg, unsigned index)
+{
+  FoldJob_t* job = arg;
+
+  if(job->partials)
+  {
+    uint64_t first = job->cycleCount * index / job->threadCount;
+    uint64_t last = job->cycleCount * (index + 1) / job->threadCount;
+    accumulatorFoldRange(&job->partials[index], job->src, first, last, 0, job->dst->length);
+  }
+  else
+  {
+    uint64_t first = job->dst->length * index / job->threadCount;
+    uint64_t last = job->dst->length * (index + 1) / job->threadCount;
+    accumulatorFoldRange(job->dst, job->src, 0, job->cycleCount, first, last);
+  }
+}
+
+void accumulatorFold(Accumulator_t* dst, const Accumulator_t* src, unsigned threadCount)
+{
+  FoldJob_t job = {dst, src, NULL, threadCount > 0 ? threadCount : 1, src->length / dst->length};
+
+  // With many short cycles every thread sums its own range of cycles, and the
+  // partial sums are added in thread order. With fewer cycles than threads
+  // every thread takes a range of bins and all cycles instead, which needs no
+  // partial sums and adds in the same order as one thread:
+  if(job.threadCount > 1 && job.cycleCount >= 2 * job.threadCount)
+  {
+    job.partials = calloc(job.threadCount, sizeof(Accumulator_t));
+    unsigned ready = 1;
+
+    if(job.partials)
+    {
+      job.partials[0] = *dst;
+      while(ready < job.threadCount && accumulatorInitLike(&job.partials[ready], dst))
+        ready++;
+    }
+
+    if(!job.partials || ready < job.threadCount)
+    {
+      for(unsigned t = 1; job.partials && t < ready; t++)
+        accumulatorFree(&job.partials[t]);
+      free(job.partials);
+      job.partials = NULL;
+    }
+  }
+
+  if(!job.partials && job.threadCount > dst->length)
+    job.threadCount = dst->length > 0 ? (unsigned) dst->length : 1;
+
+  parallelRun(accumulatorFoldTask, &job, job.threadCount);
+
+  if(job.partials)
+  {
+    // Fixed reduction order, so a run is reproducible for a given thread count:
+    for(unsigned t = 1; t < job.threadCount; t++)
+    {
+      accumulatorFoldRange(dst, &job.partials[t], 0, 1, 0, dst->length);
+      accumulatorFree(&job.partials[t]);
+    }
+
+    free(job.partials);
+  }
+
+  dst->count += src->count * job.cycleCount;
+}
+
+double accumulatorMean(const Accumulator_t* acc, uint16_t ch, uint64_t i)
+{
+  if(acc->count == 0)
+    return 0;
+
+  if(!acc->raw)
+    return (acc->data[ch][i] + (acc->sumDouble ? acc->sumDouble[ch][i] : 0)) / (double) acc->count;
+
+  const RawFormat_t* format = &acc->formats[ch];
+  int64_t sum = (acc->sum32 ? acc->sum32[ch][i] : 0) + (acc->sum64 ? acc->sum64[ch][i] : 0);
+  return ((double) sum / acc->count - format->zero) * format->scale;
+}
+
+void accumulatorMeans(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count, float* means)
+{
+  // Only the 32 bit raw sums have a vectorized conversion:
+  if(acc->raw && acc->sum32 && !acc->sum64 && acc->count > 0)
+  {
+    const RawFormat_t* format = &acc->formats[ch];
+    acc->kernels->normalizeInt32(means, acc->sum32[ch] + start, count, (double) acc->count, (double) format->zero, format->scale);
+    return;
+  }
+
+  for(uint64_t i = 0; i < count; i++)
+  {
+    means[i] = (float) accumulatorMean(acc, ch, start + i);
+  }
+}
+
+// Unbiased variance of n values from their sum and sum of squares, 0 below 2 values:
+static double variance(double sum, double squares, uint64_t n)
+{
+  if(n < 2)
+    return 0;
+
+  double v = (squares - sum * sum / n) / (n - 1);
+  return v > 0 ? v : 0;
+}
+
+void accumulatorStdErrors(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count, bool8_t blocks, float* errors)
+{
+  double scale = acc->raw ? acc->formats[ch].scale : 1;
+
+  for(uint64_t i = start; i < start + count; i++)
+  {
+    double v = 0;
+    uint64_t n = blocks ? acc->blockCount : acc->count;
+
+    if(blocks && acc->blockMeans)
+      v = n > 1 ? acc->blockM2[ch][i] / (n - 1) : 0;
+    else if(!blocks && acc->sumSquares)
+      v = variance(accumulatorSum(acc, ch, i), acc->sumSquares[ch][i], n);
+
+    errors[i - start] = n > 0 ? (float) (sqrt(v / n) * scale) : 0;
+  }
+}
+
+bool8_t accumulatorHasSquares(const Accumulator_t* acc, uint64_t start, uint64_t count)
+{
+  if(acc->sumSquares)
+    return start + count <= acc->length;
+
+  return acc->windowSquares && start >= acc->windowStart && start + count <= acc->windowStart + acc->windowLength;
+}
+
+double accumulatorNoiseRms(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count)
+{
+  if(count == 0 || !accumulatorHasSquares(acc, start, count))
+    return 0;
+
+  // The window squares start at its first bin:
+  const double* squares = acc->sumSquares ? acc->sumSquares[ch] : acc->windowSquares[ch];
+  uint64_t offset = acc->sumSquares ? 0 : acc->windowStart;
+  double sum = 0;
+  for(uint64_t i = start; i < start + count; i++)
+  {
+    sum += variance(accumulatorSum(acc, ch, i), squares[i - offset], acc->count);
+  }
+
+  return sqrt(sum / count) * (acc->raw ? acc->formats[ch].scale : 1);
+}
+
+void accumulatorFree(Accumulator_t* acc)
+{
+  freeChannels((void**) acc->data, acc->channelCount);
+  freeChannels((void**) acc->sumDouble, acc->channelCount);
+  freeChannels((void**) acc->sumSquares, acc->channelCount);
+  freeChannels((void**) acc->blockMeans, acc->channelCount);
+  freeChannels((void**) acc->blockM2, acc->channelCount);
+  freeChannels((void**) acc->blockStart, acc->channelCount);
+  freeChannels((void**) acc->windowSquares, acc->channelCount);
+  freeChannels((void**) acc->sum32, acc->channelCount);
+  freeChannels((void**) acc->sum64, acc->channelCount);
+  free(acc->formats);
+  free(acc->limits);
+  acc->data = NULL;
+  acc->sumDouble = NULL;
+  acc->sumSquares = NULL;
+  acc->blockMeans = NULL;
+  acc->blockM2 = NULL;
+  acc->blockStart = NULL;
+  acc->windowSquares = NULL;
+  acc->sum32 = NULL;
+  acc->sum64 = NULL;
+  acc->formats = NULL;
+  acc->limits = NULL;
+}
@@ -0,0 +1,142 @@
+/**
+ * Accumulator.h
+ * @author Simon Collignon
+ *
+ * Sums of acquired records, either as converted volts (ScpGetData) or as raw
+ * ADC codes (ScpGetDataRaw) which are only scaled to volts on output.
+ */
+
+#ifndef _ACCUMULATOR_H_
+#define _ACCUMULATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Kernels.h"
+
+// Cycles summed in float before they are moved into the double sums, the
+// float sums then carry at most this many roundings of the signal:
+#define ACCUMULATOR_DEFAULT_FLOAT_FLUSH_INTERVAL 64
+
+// Limits per channel a cycle is rejected beyond, raw codes or volts:
+typedef enum
+{
+  ACCUMULATOR_LIMIT_RAIL_LOW,   // samples at or below are saturated
+  ACCUMULATOR_LIMIT_RAIL_HIGH,  // samples at or above are saturated
+  ACCUMULATOR_LIMIT_LEVEL_LOW,  // samples at or below are glitches, the rail without a level
+  ACCUMULATOR_LIMIT_LEVEL_HIGH,
+  ACCUMULATOR_LIMIT_STEP,       // steps between neighbouring samples above are glitches, 0 for no limit
+  ACCUMULATOR_LIMIT_COUNT
+} AccumulatorLimit_t;
+
+typedef struct
+{
+  uint32_t type;  // DATARAWTYPE_*
+  int64_t min;    // raw code of the range minimum
+  int64_t zero;   // raw code of 0 V
+  int64_t max;    // raw code of the range maximum
+  double scale;   // volts per raw code
+} RawFormat_t;
+
+// Fold count raw samples of every channel of a record, starting at position,
+// into the 32 bit cycle bins of the channels, and their squares into the
+// squares bins unless squares is NULL:
+typedef void (*FoldKernel_t)(const Kernels_t* kernels, int32_t** sums, double** squares, void** data, uint16_t channelCount, uint64_t position, uint64_t count);
+
+typedef struct
+{
+  uint16_t channelCount;
+  uint64_t length;       // samples per channel, records are folded into cycles of this length
+  bool8_t raw;           // sum raw codes instead of volts
+  RawFormat_t* formats;  // raw format per channel, raw only
+  float** data;          // sums in volts, NULL when raw
+  double** sumDouble;    // sums in volts data is flushed into, NULL when raw or data is never flushed
+  int32_t** sum32;       // raw code sums, NULL for 32 bit raw types
+  int64_t** sum64;       // raw code sums sum32 is flushed into, NULL when sum32 can't overflow
+                         // each of them is one block holding the channels one after the other
+  double** sumSquares;   // sums of the squared samples, raw codes or volts, NULL without variance
+  double** blockMeans;   // running mean of the per block means, NULL without variance across blocks
+  double** blockM2;      // sums of the squared deviations of the per block means from blockMeans
+  double** blockStart;   // sums when the current block started
+  double** windowSquares; // sums of the squared samples of bins [windowStart, windowStart + windowLength) only,
+  uint64_t windowStart;  // NULL without them or with sumSquares
+  uint64_t windowLength;
+  double* limits;        // ACCUMULATOR_LIMIT_COUNT per channel, NULL without rejection
+  uint64_t saturatedCount; // cycles rejected for samples on the rails
+  uint64_t glitchCount;  // cycles rejected for samples beyond the levels or steps beyond the limit
+  uint64_t blockCount;   // blocks ended by accumulatorEndBlock
+  uint64_t blockStartCount; // count when the current block started
+  uint64_t count;        // number of cycles summed in every sample
+  uint64_t pending;      // number of cycles summed in sum32 or data since the last flush
+  uint64_t flushInterval; // number of cycles sum32 can hold without overflow, or data without losing precision
+  FoldKernel_t fold;     // kernel specialized for length and the raw type, NULL if there is none
+  const Kernels_t* kernels; // inner loops for this CPU
+} Accumulator_t;
+
+// Read the raw data type and scaling of a channel, returns BOOL8_FALSE if unsupported:
+bool8_t rawFormatGet(LibTiePieHandle_t scp, uint16_t ch, RawFormat_t* format);
+
+// Size in bytes of one raw sample:
+size_t rawSampleSize(uint32_t type);
+
+// Allocate zeroed sums for up to maxCount cycles of length samples. Volts are
+// summed in float and moved into double sums every floatFlushInterval cycles,
+// 0 keeps them in float:
+bool8_t accumulatorInit(Accumulator_t* acc, LibTiePieHandle_t scp, uint16_t channelCount, uint64_t length, bool8_t raw, uint64_t maxCount, uint64_t floatFlushInterval);
+
+// Also sum the squares of the samples, in the same pass, for the variance
+// across cycles, and with blocks the means of every block for the variance
+// across blocks. The squares cost a read-modify-write of a double per sample
+// added, and every block end a pass over four doubles per sample. Call before
+// the first cycle is added:
+bool8_t accumulatorEnableVariance(Accumulator_t* acc, bool8_t blocks);
+
+// Only sum the squares of bins [start, start + length), for the variance
+// there, in a pass over those samples after the sums. Nothing to do with
+// variance enabled. Call before the first cycle is added, not folded by
+// accumulatorFold:
+bool8_t accumulatorEnableWindowSquares(Accumulator_t* acc, uint64_t start, uint64_t length);
+
+// Check every sample of a cycle while it is added and take the cycle back out
+// when a channel has a sample on the rails of its range, beyond level volts
+// from 0 or a step above step volts to the next sample, level and step 0 for
+// no limit. Only cycles added by one accumulatorAdd call are rejected, so the
+// calls must hold whole cycles. Returns BOOL8_FALSE for raw types without a
+// check kernel:
+bool8_t accumulatorEnableRejection(Accumulator_t* acc, LibTiePieHandle_t scp, double level, double step);
+
+// Add the means of the cycles since the previous call to the block variance:
+void accumulatorEndBlock(Accumulator_t* acc);
+
+// Fold samples [position, position + count) of a record into the sums, data
+// holds one float* or raw buffer per channel, matching acc->raw. A cycle is
+// counted once its last sample is added, so records must hold whole cycles:
+void accumulatorAdd(Accumulator_t* acc, void** data, uint64_t position, uint64_t count);
+
+// Fold src into dst, every cycle of dst->length samples of src is added to dst.
+// dst must be allocated for at least as many records as src. The work is
+// split over threadCount threads:
+void accumulatorFold(Accumulator_t* dst, const Accumulator_t* src, unsigned threadCount);
+
+// Average in volts of sample i of channel ch:
+double accumulatorMean(const Accumulator_t* acc, uint16_t ch, uint64_t i);
+
+// Averages of samples [start, start + count) of channel ch, rounded to float:
+void accumulatorMeans(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count, float* means);
+
+// Standard errors in volts of the means of samples [start, start + count) of
+// channel ch, from the variance across cycles, or across blocks with blocks.
+// 0 where there are fewer than 2 cycles or blocks:
+void accumulatorStdErrors(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count, bool8_t blocks, float* errors);
+
+// Whether the squares of samples [start, start + count) are summed:
+bool8_t accumulatorHasSquares(const Accumulator_t* acc, uint64_t start, uint64_t count);
+
+// Root mean square over samples [start, start + count) of channel ch of the
+// standard deviation across cycles in volts, the noise of a single cycle, 0
+// when their squares aren't summed:
+double accumulatorNoiseRms(const Accumulator_t* acc, uint16_t ch, uint64_t start, uint64_t count);
+
+void accumulatorFree(Accumulator_t* acc);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * ArchiveBenchmark.c
+ * @author Simon Collignon
+ *
+ * This code measures how fast raw blocks are archived to a disk, the way
+ * rawArchive does it: a preallocated file mapped into memory, written chunk
+ * by chunk at the places the transfer hands to the driver. The driver's
+ * writes are stood in for by memcpy, no oscilloscope is needed. Run it on
+ * the disk the data goes to, the archive is as large as all the blocks and
+ * is deleted afterwards.
+ *
+ *   ArchiveBenchmark [samples per block] [blocks] [channels] [sample rate] [directory]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "OutputFile.h"
+#include "RawArchive.h"
+#include "Transfer.h" // for TRANSFER_DEFAULT_CHUNK_LENGTH
+#include "Utils.h"
+
+static void printRate(const char* phase, double seconds, uint64_t bytes, uint64_t blockCount, uint64_t samples)
+{
+  printf("%-18s %10.3f %10.2f %10.2f %12.1f" NEWLINE, phase, seconds, bytes / seconds * 1e-9, blockCount / seconds, samples / seconds * 1e-6);
+}
+
+int main(int argc, char* argv[])
+{
+  int status = EXIT_SUCCESS;
+  uint64_t length = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+  uint64_t blockCount = argc > 2 ? strtoull(argv[2], NULL, 10) : 20;
+  uint16_t channelCount = argc > 3 ? (uint16_t) strtoul(argv[3], NULL, 10) : 2;
+  double fs = argc > 4 ? strtod(argv[4], NULL) : 500e6;
+  const char* directory = argc > 5 ? argv[5] : ".";
+
+  if(length == 0 || blockCount == 0 || channelCount == 0 || channelCount > RAW_ARCHIVE_MAX_CHANNELS)
+  {
+    fprintf(stderr, "Usage: ArchiveBenchmark [samples per block] [blocks] [channels, up to %d] [sample rate] [directory]" NEWLINE, RAW_ARCHIVE_MAX_CHANNELS);
+    return EXIT_FAILURE;
+  }
+
+  // 12 bit codes in 16 bits, as the scope transfers them:
+  RawFormat_t formats[RAW_ARCHIVE_MAX_CHANNELS];
+  Accumulator_t acc = {0};
+  acc.channelCount = channelCount;
+  acc.raw = BOOL8_TRUE;
+  acc.formats = formats;
+
+  for(uint16_t ch = 0; ch < channelCount; ch++)
+  {
+    formats[ch] = (RawFormat_t) {DATARAWTYPE_INT16, -2048, 0, 2047, 1.0 / 2048};
+  }
+
+  uint64_t chunkLength = length < TRANSFER_DEFAULT_CHUNK_LENGTH ? length : TRANSFER_DEFAULT_CHUNK_LENGTH;
+  int16_t* codes = malloc(sizeof(int16_t) * chunkLength);
+  char filename[OUTPUT_PATH_LENGTH];
+  snprintf(filename, sizeof(filename), "%s/archive_benchmark_raw.bin", directory);
+
+  if(!codes)
+  {
+    fprintf(stderr, "Couldn't allocate the benchmark buffer!" NEWLINE);
+    return EXIT_FAILURE;
+  }
+
+  for(uint64_t i = 0; i < chunkLength; i++)
+  {
+    codes[i] = (int16_t) ((i * 2654435761u) % 4096) - 2048;
+  }
+
+  uint64_t bytes = blockCount * channelCount * length * sizeof(int16_t);
+  printf("%" PRIu16 " channels of %" PRIu64 " samples per block, %" PRIu64 " blocks, %.3f GB to %s" NEWLINE,
+    channelCount, length, blockCount, bytes * 1e-9, filename);
+
+  RawArchive_t archive;
+  double start = monotonicSeconds();
+
+  if(rawArchiveOpen(&archive, filename, &acc, length, 1, length, fs, blockCount))
+  {
+    double opened = monotonicSeconds();
+    printf("preallocated in %.3f s" NEWLINE, opened - start);
+    printf("%-18s %10s %10s %10s %12s" NEWLINE, "phase", "s", "GB/s", "blocks/s", "MSa/s per ch");
+
+    // Chunk by chunk, alternating the slots as the async transfer does:
+    for(uint64_t b = 0; b < blockCount; b++)
+    {
+      for(uint64_t s = 0, k = 0; s < length; s += chunkLength, k++)
+      {
+        uint64_t count = length - s < chunkLength ? length - s : chunkLength;
+        void** views = rawArchiveChunk(&archive, (unsigned) (k % 2), 0, s);
+
+        for(uint16_t ch = 0; ch < channelCount; ch++)
+        {
+          memcpy(views[ch], codes, sizeof(int16_t) * count);
+        }
+      }
+
+      rawArchiveEndBlock(&archive);
+    }
+
+    double written = monotonicSeconds();
+    bool8_t flushed = rawArchiveFlush(&archive);
+    double end = monotonicSeconds();
+
+    printRate("write to mapping", written - opened, bytes, blockCount, blockCount * length);
+    printRate("flush to disk", end - written, bytes, blockCount, blockCount * length);
+    printRate("sustained", end - opened, bytes, blockCount, blockCount * length);
+
+    // Continuous acquisition is the worst case, blocks have dead time between them:
+    double lineRate = channelCount * fs * sizeof(int16_t);
+    double sustained = bytes / (end - opened);
+    printf("line rate at %.0f MSa/s: %.2f GB/s, %s" NEWLINE, fs * 1e-6, lineRate * 1e-9,
+      sustained >= lineRate ? "the archive keeps up" : "the archive falls behind");
+
+    if(!flushed || !rawArchiveClose(&archive))
+    {
+      fprintf(stderr, "Couldn't write the archive: %s" NEWLINE, filename);
+      status = EXIT_FAILURE;
+    }
+
+    remove(filename);
+  }
+  else
+  {
+    status = EXIT_FAILURE;
+  }
+
+  free(codes);
+
+  return status;
+}
@@ -0,0 +1,93 @@
+/**
+ * BinaryOutput.c
+ * @author Simon Collignon
+ *
+ * The text goes through stdio, it is a few hundred bytes. The columns are
+ * the bulk of the file and are written as they are in memory, with the
+ * padding before them, by a single writev on POSIX.
+ */
+
+#include "BinaryOutput.h"
+#include <string.h>
+#include "Utils.h" // for OS_WINDOWS
+#ifndef OS_WINDOWS
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+void binaryHeaderInit(BinaryHeader_t* header, uint16_t channelCount, uint16_t columnCount, uint64_t rowCount, const Roi_t* roi, uint64_t cycleLength, uint64_t averageCount, double fs)
+{
+  memset(header, 0, sizeof(BinaryHeader_t));
+  memcpy(header->magic, BINARY_MAGIC, sizeof(header->magic));
+  header->version = BINARY_VERSION;
+  header->rowCount = rowCount;
+  header->columnCount = columnCount;
+  header->channelCount = channelCount;
+  header->roiCount = roi ? roi->count : 0;
+  header->cycleLength = cycleLength;
+  header->averageCount = averageCount;
+  header->fs = fs;
+
+  for(uint16_t w = 0; w < header->roiCount; w++)
+  {
+    header->roiStart[w] = roi->start[w];
+    header->roiLength[w] = roi->length[w];
+  }
+}
+
+bool8_t binaryWriteHeader(FILE* file, BinaryHeader_t* header)
+{
+  return fwrite(header, sizeof(BinaryHeader_t), 1, file) == 1;
+}
+
+#ifndef OS_WINDOWS
+// writev until every part is written, a call may write only some of them:
+static bool8_t writeAll(int fd, struct iovec* parts, int count)
+{
+  while(count > 0)
+  {
+    ssize_t written = writev(fd, parts, count);
+    if(written < 0)
+      return BOOL8_FALSE;
+
+    for(; count > 0 && (size_t) written >= parts->iov_len; parts++, count--)
+    {
+      written -= parts->iov_len;
+    }
+
+    if(count > 0)
+    {
+      parts->iov_base = (char*) parts->iov_base + written;
+      parts->iov_len -= written;
+    }
+  }
+
+  return BOOL8_TRUE;
+}
+#endif
+
+bool8_t binaryWriteData(FILE* file, BinaryHeader_t* header, const float* values)
+{
+  static const char zeros[BINARY_ALIGNMENT] = {0};
+
+  long end = ftell(file);
+  if(end < (long) sizeof(BinaryHeader_t) || fflush(file) != 0)
+    return BOOL8_FALSE;
+
+  header->textLength = end - sizeof(BinaryHeader_t);
+  header->dataOffset = (uint32_t) ((end + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT);
+
+  size_t padding = header->dataOffset - end;
+  size_t size = sizeof(float) * header->columnCount * header->rowCount;
+
+#ifdef OS_WINDOWS
+  if(fwrite(zeros, 1, padding, file) != padding || fwrite(values, 1, size, file) != size || fflush(file) != 0)
+    return BOOL8_FALSE;
+#else // POSIX
+  struct iovec parts[2] = {{(void*) zeros, padding}, {(void*) values, size}};
+  if(!writeAll(fileno(file), parts, 2))
+    return BOOL8_FALSE;
+#endif
+
+  return fseek(file, 0, SEEK_SET) == 0 && binaryWriteHeader(file, header);
+}
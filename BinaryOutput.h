@@ -0,0 +1,58 @@
+/**
+ * BinaryOutput.h
+ * @author Simon Collignon
+ *
+ * Binary alternative to the csv data section: a fixed little-endian header,
+ * the csv header lines as text, then the columns of the csv file as float
+ * arrays, one after the other, which numpy maps straight from the file.
+ *
+ * Layout:
+ *   BinaryHeader_t
+ *   textLength bytes of text, the csv header lines and column names line
+ *   zeros up to dataOffset, a multiple of BINARY_ALIGNMENT
+ *   columnCount arrays of rowCount float32
+ */
+
+#ifndef _BINARYOUTPUT_H_
+#define _BINARYOUTPUT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Roi.h"
+
+#define BINARY_MAGIC "TPAVGBIN"
+#define BINARY_VERSION 1
+#define BINARY_ALIGNMENT 64 // bytes, the data starts on a cache line
+
+typedef struct
+{
+  char magic[8];          // BINARY_MAGIC, not 0 terminated
+  uint32_t version;       // BINARY_VERSION
+  uint32_t dataOffset;    // bytes from the start of the file to the first column
+  uint64_t textLength;    // bytes of text following the header
+  uint64_t rowCount;      // samples per column
+  uint16_t columnCount;   // float32 columns, means then standard errors as in the csv file
+  uint16_t channelCount;
+  uint16_t roiCount;      // windows the rows come from, 0 for the whole cycle
+  uint16_t reserved;
+  uint64_t cycleLength;   // Sa
+  uint64_t averageCount;  // cycles in the means
+  double fs;              // Sa/s
+  uint64_t roiStart[ROI_MAX_COUNT];  // Sa, in the cycle
+  uint64_t roiLength[ROI_MAX_COUNT]; // Sa
+} BinaryHeader_t;
+
+// Fill the header of an output of rowCount rows, roi may be NULL:
+void binaryHeaderInit(BinaryHeader_t* header, uint16_t channelCount, uint16_t columnCount, uint64_t rowCount, const Roi_t* roi, uint64_t cycleLength, uint64_t averageCount, double fs);
+
+// Write the header with its text still unknown, the text follows from the
+// current position of file, which must be opened in binary mode:
+bool8_t binaryWriteHeader(FILE* file, BinaryHeader_t* header);
+
+// Write the columnCount columns of header->rowCount floats at values + c *
+// rowCount after the text in one go, and the header again with the lengths
+// of the text and the padding:
+bool8_t binaryWriteData(FILE* file, BinaryHeader_t* header, const float* values);
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * Config.c
+ * @author Simon Collignon
+ *
+ * Keys are the field names of Config_t, looked up in a table of offsets so a
+ * new parameter only needs a field and a table entry.
+ */
+
+#include "Config.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include "Transfer.h" // for TRANSFER_DEFAULT_CHUNK_LENGTH and ACCUMULATOR_DEFAULT_FLOAT_FLUSH_INTERVAL
+#include "Utils.h" // for NEWLINE and OS_WINDOWS
+
+typedef enum
+{
+  CONFIG_DOUBLE,
+  CONFIG_UINT64,
+  CONFIG_BOOL,
+  CONFIG_ROI,
+  CONFIG_PATH
+} ConfigType_t;
+
+typedef struct
+{
+  const char* key;
+  ConfigType_t type;
+  size_t offset;
+} ConfigKey_t;
+
+#define CONFIG_KEY(field, type) {#field, type, offsetof(Config_t, field)}
+
+static const ConfigKey_t ConfigKeys[] = {
+  CONFIG_KEY(sampleFrequency, CONFIG_DOUBLE),
+  CONFIG_KEY(recordLength, CONFIG_UINT64),
+  CONFIG_KEY(triggerDelay, CONFIG_DOUBLE),
+  CONFIG_KEY(range, CONFIG_DOUBLE),
+  CONFIG_KEY(channelCount, CONFIG_UINT64),
+  CONFIG_KEY(referenceRange, CONFIG_DOUBLE),
+  CONFIG_KEY(resolution, CONFIG_UINT64),
+  CONFIG_KEY(blockCount, CONFIG_UINT64),
+  CONFIG_KEY(cycleLength, CONFIG_UINT64),
+  CONFIG_KEY(segmented, CONFIG_BOOL),
+  CONFIG_KEY(segmentLength, CONFIG_UINT64),
+  CONFIG_KEY(roi, CONFIG_ROI),
+  CONFIG_KEY(streaming, CONFIG_BOOL),
+  CONFIG_KEY(streamCycleCount, CONFIG_UINT64),
+  CONFIG_KEY(rawData, CONFIG_BOOL),
+  CONFIG_KEY(floatFlushInterval, CONFIG_UINT64),
+  CONFIG_KEY(variance, CONFIG_BOOL),
+  CONFIG_KEY(foldEachBlock, CONFIG_BOOL),
+  CONFIG_KEY(chunkLength, CONFIG_UINT64),
+  CONFIG_KEY(overlapTransfer, CONFIG_BOOL),
+  CONFIG_KEY(threadCount, CONFIG_UINT64),
+  CONFIG_KEY(phaseCorrection, CONFIG_BOOL),
+  CONFIG_KEY(referenceChannel, CONFIG_UINT64),
+  CONFIG_KEY(referenceFrequency, CONFIG_DOUBLE),
+  CONFIG_KEY(referenceWindow, CONFIG_UINT64),
+  CONFIG_KEY(triggerAlignment, CONFIG_BOOL),
+  CONFIG_KEY(alignmentChannel, CONFIG_UINT64),
+  CONFIG_KEY(alignmentEdge, CONFIG_UINT64),
+  CONFIG_KEY(alignmentMaxDelay, CONFIG_UINT64),
+  CONFIG_KEY(rejection, CONFIG_BOOL),
+  CONFIG_KEY(glitchLevel, CONFIG_DOUBLE),
+  CONFIG_KEY(glitchStep, CONFIG_DOUBLE),
+  CONFIG_KEY(snapshotFirst, CONFIG_UINT64),
+  CONFIG_KEY(snapshotRatio, CONFIG_DOUBLE),
+  CONFIG_KEY(snrChannel, CONFIG_UINT64),
+  CONFIG_KEY(noiseStart, CONFIG_UINT64),
+  CONFIG_KEY(noiseLength, CONFIG_UINT64),
+  CONFIG_KEY(signalStart, CONFIG_UINT64),
+  CONFIG_KEY(signalLength, CONFIG_UINT64),
+  CONFIG_KEY(targetSnr, CONFIG_DOUBLE),
+  CONFIG_KEY(targetStdError, CONFIG_DOUBLE),
+  CONFIG_KEY(dataReadyTimeout, CONFIG_DOUBLE),
+  CONFIG_KEY(timeColumn, CONFIG_BOOL),
+  CONFIG_KEY(binaryOutput, CONFIG_BOOL),
+  CONFIG_KEY(outputDirectory, CONFIG_PATH),
+  CONFIG_KEY(runCount, CONFIG_UINT64),
+  CONFIG_KEY(writerQueueLength, CONFIG_UINT64),
+  CONFIG_KEY(rawArchive, CONFIG_BOOL)
+};
+
+#define CONFIG_KEY_COUNT (sizeof(ConfigKeys) / sizeof(ConfigKeys[0]))
+
+void configDefaults(Config_t* config)
+{
+  config->sampleFrequency = 500e6;
+  config->recordLength = 50000000;
+  config->triggerDelay = 400e-9;
+  config->range = 0.4;
+  config->channelCount = 1;
+  config->referenceRange = 4;
+  config->resolution = 12;
+  config->blockCount = 20;
+  config->cycleLength = 10000;
+  config->segmented = BOOL8_FALSE;
+  config->segmentLength = 0;
+  roiParse(&config->roi, "none");
+  config->streaming = BOOL8_FALSE;
+  config->streamCycleCount = 100;
+  config->rawData = BOOL8_TRUE;
+  config->floatFlushInterval = ACCUMULATOR_DEFAULT_FLOAT_FLUSH_INTERVAL;
+  config->variance = BOOL8_FALSE;
+  config->foldEachBlock = BOOL8_TRUE;
+  config->chunkLength = TRANSFER_DEFAULT_CHUNK_LENGTH;
+  config->overlapTransfer = BOOL8_TRUE;
+  config->threadCount = 0;
+  config->phaseCorrection = BOOL8_FALSE;
+  config->referenceChannel = 1;
+  config->referenceFrequency = 10e6;
+  config->referenceWindow = 4096;
+  config->triggerAlignment = BOOL8_FALSE;
+  config->alignmentChannel = 0;
+  config->alignmentEdge = 512;
+  config->alignmentMaxDelay = 8;
+  config->rejection = BOOL8_FALSE;
+  config->glitchLevel = 0;
+  config->glitchStep = 0;
+  config->snapshotFirst = 0;
+  config->snapshotRatio = 10;
+  config->snrChannel = 0;
+  config->noiseStart = 0;
+  config->noiseLength = 0;
+  config->signalStart = 0;
+  config->signalLength = 0;
+  config->targetSnr = 0;
+  config->targetStdError = 0;
+  config->dataReadyTimeout = 10;
+  config->timeColumn = BOOL8_TRUE;
+  config->binaryOutput = BOOL8_FALSE;
+#ifdef OS_WINDOWS
+  snprintf(config->outputDirectory, CONFIG_PATH_LENGTH, "C:\\Users\\labo-admin\\Documents\\spectrometer-controller\\tiepie\\data");
+#else // POSIX
+  snprintf(config->outputDirectory, CONFIG_PATH_LENGTH, "data");
+#endif
+  config->runCount = 1;
+  config->writerQueueLength = 2;
+  config->rawArchive = BOOL8_FALSE;
+}
+
+bool8_t configSet(Config_t* config, const char* key, const char* value)
+{
+  for(size_t k = 0; k < CONFIG_KEY_COUNT; k++)
+  {
+    if(strcmp(ConfigKeys[k].key, key) != 0)
+      continue;
+
+    void* field = (char*) config + ConfigKeys[k].offset;
+    char* end;
+
+    switch(ConfigKeys[k].type)
+    {
+      case CONFIG_DOUBLE:
+        *(double*) field = strtod(value, &end);
+        break;
+      case CONFIG_UINT64:
+      {
+        // Through strtod, so 5e6 is accepted as well, but only whole numbers
+        // a uint64_t holds, the conversion of others is undefined:
+        double number = strtod(value, &end);
+        if(end == value || *end != '\0' || !(number >= 0 && number < 18446744073709551616.0) || number != (double) (uint64_t) number)
+        {
+          fprintf(stderr, "Invalid value for %s, expected a whole number from 0: %s" NEWLINE, key, value);
+          return BOOL8_FALSE;
+        }
+        *(uint64_t*) field = (uint64_t) number;
+        return BOOL8_TRUE;
+      }
+      case CONFIG_BOOL:
+        if(strcmp(value, "true") == 0 || strcmp(value, "false") == 0)
+        {
+          *(bool8_t*) field = value[0] == 't';
+          return BOOL8_TRUE;
+        }
+        *(bool8_t*) field = strtol(value, &end, 10) != 0;
+        break;
+      case CONFIG_ROI:
+        if(!roiParse((Roi_t*) field, value))
+        {
+          fprintf(stderr, "Invalid value for %s, expected ascending start:length windows: %s" NEWLINE, key, value);
+          return BOOL8_FALSE;
+        }
+        return BOOL8_TRUE;
+      case CONFIG_PATH:
+        if(strlen(value) >= CONFIG_PATH_LENGTH)
+        {
+          fprintf(stderr, "Value for %s longer than %d characters: %s" NEWLINE, key, CONFIG_PATH_LENGTH - 1, value);
+          return BOOL8_FALSE;
+        }
+        strcpy((char*) field, value);
+        return BOOL8_TRUE;
+    }
+
+    if(end == value || *end != '\0')
+    {
+      fprintf(stderr, "Invalid value for %s: %s" NEWLINE, key, value);
+      return BOOL8_FALSE;
+    }
+
+    return BOOL8_TRUE;
+  }
+
+  fprintf(stderr, "Unknown parameter: %s" NEWLINE, key);
+  return BOOL8_FALSE;
+}
+
+// Strip leading and trailing white space in place:
+static char* trim(char* s)
+{
+  while(isspace((unsigned char) *s))
+    s++;
+
+  char* end = s + strlen(s);
+  while(end > s && isspace((unsigned char) end[-1]))
+    end--;
+
+  *end = '\0';
+  return s;
+}
+
+// Split "key = value" at the '=', returns BOOL8_FALSE if there is none:
+static bool8_t configSetLine(Config_t* config, char* line)
+{
+  char* separator = strchr(line, '=');
+  if(!separator)
+    return BOOL8_FALSE;
+
+  *separator = '\0';
+  return configSet(config, trim(line), trim(separator + 1));
+}
+
+bool8_t configLoad(Config_t* config, const char* filename)
+{
+  FILE* file = fopen(filename, "r");
+
+  if(!file)
+  {
+    fprintf(stderr, "Couldn't open config file: %s" NEWLINE, filename);
+    return BOOL8_FALSE;
+  }
+
+  bool8_t ok = BOOL8_TRUE;
+  char line[256];
+  unsigned lineNumber = 0;
+
+  while(fgets(line, sizeof(line), file))
+  {
+    lineNumber++;
+
+    // The rest of a longer line would be read as a line of its own:
+    int c = strchr(line, '\n') ? '\n' : fgetc(file);
+    if(c != '\n' && c != EOF)
+    {
+      fprintf(stderr, "%s:%u: line longer than %d characters" NEWLINE, filename, lineNumber, (int) sizeof(line) - 1);
+      ok = BOOL8_FALSE;
+
+      while((c = fgetc(file)) != EOF && c != '\n')
+      {
+      }
+      continue;
+    }
+
+    char* comment = strchr(line, '#');
+    if(comment)
+      *comment = '\0';
+
+    char* text = trim(line);
+    if(*text == '\0')
+      continue;
+
+    if(!configSetLine(config, text))
+    {
+      fprintf(stderr, "%s:%u: expected key = value" NEWLINE, filename, lineNumber);
+      ok = BOOL8_FALSE;
+    }
+  }
+
+  fclose(file);
+  return ok;
+}
+
+// Values no setting accepts, checked once all of them are applied:
+static bool8_t configCheck(const Config_t* config)
+{
+  if(config->channelCount < 1)
+  {
+    fprintf(stderr, "Invalid value for channelCount, at least Ch1 is averaged: %" PRIu64 NEWLINE, config->channelCount);
+    return BOOL8_FALSE;
+  }
+
+  if(config->streaming && config->segmented)
+  {
+    fprintf(stderr, "Invalid combination, streaming records have no segments: streaming = true and segmented = true" NEWLINE);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+bool8_t configParseArgs(Config_t* config, int argc, char* argv[])
+{
+  for(int i = 1; i < argc; i++)
+  {
+    // A copy of any length, configSetLine splits it in place:
+    size_t length = strlen(argv[i]);
+    char* arg = malloc(length + 1);
+
+    if(!arg)
+    {
+      fprintf(stderr, "Couldn't copy the argument: %s" NEWLINE, argv[i]);
+      return BOOL8_FALSE;
+    }
+
+    memcpy(arg, argv[i], length + 1);
+    bool8_t ok = strchr(arg, '=') ? configSetLine(config, arg) : configLoad(config, arg);
+    free(arg);
+
+    if(!ok)
+      return BOOL8_FALSE;
+  }
+
+  return configCheck(config);
+}
+
+void configPrint(const Config_t* config, FILE* file)
+{
+  for(size_t k = 0; k < CONFIG_KEY_COUNT; k++)
+  {
+    const void* field = (const char*) config + ConfigKeys[k].offset;
+
+    switch(ConfigKeys[k].type)
+    {
+      case CONFIG_DOUBLE:
+        fprintf(file, "%s = %g" NEWLINE, ConfigKeys[k].key, *(const double*) field);
+        break;
+      case CONFIG_UINT64:
+        fprintf(file, "%s = %" PRIu64 NEWLINE, ConfigKeys[k].key, *(const uint64_t*) field);
+        break;
+      case CONFIG_BOOL:
+        fprintf(file, "%s = %s" NEWLINE, ConfigKeys[k].key, *(const bool8_t*) field ? "true" : "false");
+        break;
+      case CONFIG_ROI:
+        fprintf(file, "%s = ", ConfigKeys[k].key);
+        roiPrint((const Roi_t*) field, file);
+        fprintf(file, NEWLINE);
+        break;
+      case CONFIG_PATH:
+        fprintf(file, "%s = %s" NEWLINE, ConfigKeys[k].key, (const char*) field);
+        break;
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * Config.h
+ * @author Simon Collignon
+ *
+ * Parameters of an averaging run, read from "key = value" config files and
+ * key=value command line arguments, so a run is retuned without recompiling.
+ */
+
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Roi.h"
+
+// Bytes of a path parameter, with the terminating 0:
+#define CONFIG_PATH_LENGTH 192
+
+typedef struct
+{
+  double sampleFrequency;   // Hz
+  uint64_t recordLength;    // Sa
+  double triggerDelay;      // s, position of the trigger in the record
+  double range;             // V, Ch1
+  uint64_t channelCount;    // channels averaged together, Ch1 and the reference channels after it
+  double referenceRange;    // V, reference channels
+  uint64_t resolution;      // bits
+  uint64_t blockCount;      // number of acquisition blocks that are averaged together
+  uint64_t cycleLength;     // Sa per FID cycle, 0 keeps the whole record as one cycle
+  bool8_t segmented;        // one segment per FID trigger
+  uint64_t segmentLength;   // Sa per segment, 0 for cycleLength
+  Roi_t roi;                // "start:length, ..." Sa windows of the cycle that are transferred and averaged, none for the whole cycle
+  bool8_t streaming;        // stream continuously instead of arming per block
+  uint64_t streamCycleCount; // FID cycles per stream record
+  bool8_t rawData;          // sum raw ADC codes instead of volts
+  uint64_t floatFlushInterval; // cycles summed in float before they are moved into double, 0 keeps float
+  bool8_t variance;         // write standard errors next to the means, a double per bin summed for every sample, and per record sample without foldEachBlock
+  bool8_t foldEachBlock;    // fold each block into the cycle bins as it arrives
+  uint64_t chunkLength;     // Sa per transfer call, 0 transfers the whole record
+  bool8_t overlapTransfer;  // fold a chunk while the next one is transferred
+  uint64_t threadCount;     // threads folding the record sums into cycles and aligning cycles, 0 for one per core
+  bool8_t phaseCorrection;  // align every cycle on the reference tone before it is accumulated
+  uint64_t referenceChannel; // channel index of the reference tone, 1 for Ch2
+  double referenceFrequency; // Hz, reference tone
+  uint64_t referenceWindow;  // Sa at the start of each cycle the reference phase is measured on
+  bool8_t triggerAlignment; // align every cycle on the leading edge of the previous ones
+  uint64_t alignmentChannel; // channel index whose leading edge is matched, 0 for Ch1
+  uint64_t alignmentEdge;    // Sa at the start of each cycle that are cross-correlated
+  uint64_t alignmentMaxDelay; // Sa, largest trigger jitter searched either way
+  bool8_t rejection;        // leave out cycles with a saturated sample or a glitch
+  double glitchLevel;       // V, samples beyond this from 0 are glitches, 0 for no limit
+  double glitchStep;        // V, steps between neighbouring samples above this are glitches, 0 for no limit
+  uint64_t snapshotFirst;   // cycles in the first snapshot of the running average, 0 for none
+  double snapshotRatio;     // cycle count of each further snapshot over the previous one
+  uint64_t snrChannel;      // channel index whose SNR is estimated, 0 for Ch1
+  uint64_t noiseStart;      // Sa, signal-free window of the cycle the noise is measured in
+  uint64_t noiseLength;     // Sa, 0 for no SNR estimate, the squares of these samples are summed for it
+  uint64_t signalStart;     // Sa, window of the cycle the signal amplitude is measured in
+  uint64_t signalLength;    // Sa
+  double targetSnr;         // stop once the SNR of the average reaches this, 0 for no target
+  double targetStdError;    // V, stop once the noise of the average is below this, 0 for no target
+  double dataReadyTimeout;  // s, give up when a block or an async chunk transfer takes longer than this
+  bool8_t timeColumn;       // write the time of each sample in the first column
+  bool8_t binaryOutput;     // write the means to a .bin file instead of the csv file
+  char outputDirectory[CONFIG_PATH_LENGTH]; // the output files go here, empty for the working directory
+  uint64_t runCount;        // runs acquired one after the other, each to its own files
+  uint64_t writerQueueLength; // results written in the background at once, 0 to write them before the next run
+  bool8_t rawArchive;       // keep every raw block in <stem>_raw.bin, transferred straight into it
+} Config_t;
+
+// Settings of OscilloscopeAveraging.c before it was parameterized:
+void configDefaults(Config_t* config);
+
+// Set one key from its text value, returns BOOL8_FALSE for unknown keys or bad values:
+bool8_t configSet(Config_t* config, const char* key, const char* value);
+
+// Read "key = value" lines, # starts a comment:
+bool8_t configLoad(Config_t* config, const char* filename);
+
+// Every argument is either key=value or the name of a config file, applied in
+// order, then the settings are checked:
+bool8_t configParseArgs(Config_t* config, int argc, char* argv[]);
+
+void configPrint(const Config_t* config, FILE* file);
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * CsvOutput.c
+ * @author Simon Collignon
+ *
+ * The values are scaled a block of rows at a time into columns, so the
+ * accumulator is read channel by channel and only the printing goes row by
+ * row. The rows are formatted by hand into a large buffer, printf parsing
+ * its format for every value took most of the time of writing a file.
+ */
+
+#include "CsvOutput.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include "Utils.h" // for OS_WINDOWS
+
+// Rows are formatted into a buffer this large and written with one fwrite:
+#define CSV_BUFFER_SIZE 32768
+#define CSV_MAX_FIELD_LENGTH 32
+
+// The C runtime of Windows writes at least 3 exponent digits, e-008:
+#ifdef OS_WINDOWS
+#  define CSV_EXPONENT_DIGITS 3
+#else
+#  define CSV_EXPONENT_DIGITS 2
+#endif
+
+// Powers of ten that are exact in double:
+static const double Pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define POW10_MAX ((int) (sizeof(Pow10) / sizeof(Pow10[0])) - 1)
+
+static const char DigitPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// Write the count lowest decimal digits of n, the last one just before end.
+// Four digits at a time, the two pairs of a group don't wait on each other:
+static void writeDigits(char* end, uint32_t n, int count)
+{
+  for(; count >= 4; count -= 4, n /= 10000)
+  {
+    uint32_t group = n % 10000;
+    end -= 4;
+    memcpy(end, DigitPairs + group / 100 * 2, 2);
+    memcpy(end + 2, DigitPairs + group % 100 * 2, 2);
+  }
+  if(count >= 2)
+  {
+    end -= 2;
+    memcpy(end, DigitPairs + n % 100 * 2, 2);
+    n /= 100;
+    count -= 2;
+  }
+  if(count)
+    *--end = '0' + n % 10;
+}
+
+// Write value to out as "%.<precision>e" does, returns the number of chars.
+// The digits come from one correctly rounded scaling by a power of ten, and
+// values it can't round for sure, too close to a tie or out of its range,
+// are left to snprintf, so the text is the same as printf's. The range is
+// 10^(precision - 22) to 10^precision, a precision up to 8 keeps the digits
+// in 32 bits:
+static int formatExponent(char* out, double value, int precision)
+{
+  double a = fabs(value);
+
+  // Decimal exponent from the binary one, 78913 / 2^18 is log10(2), it may be
+  // one too small:
+  uint64_t bits;
+  memcpy(&bits, &a, sizeof(bits));
+  int k = ((int) (bits >> 52) - 1023) * 78913 >> 18;
+  int q = precision - k;
+
+  if(precision > 8 || q < 1 || q > POW10_MAX || !(a > 0))
+    return snprintf(out, CSV_MAX_FIELD_LENGTH, "%.*e", precision, value);
+
+  // Without a branch, half the values would mispredict it:
+  int up = a * Pow10[q] >= Pow10[precision + 1];
+  double scaled = a * Pow10[q - up];
+  k += up;
+
+  double whole = (double) (uint32_t) scaled;
+  double fraction = scaled - whole;
+
+  if(scaled < Pow10[precision] || fabs(fraction - 0.5) <= scaled * 1e-15)
+    return snprintf(out, CSV_MAX_FIELD_LENGTH, "%.*e", precision, value);
+
+  uint32_t digits = (uint32_t) whole + (fraction > 0.5 ? 1 : 0);
+  if(digits == (uint32_t) Pow10[precision + 1])
+  {
+    digits /= 10;
+    k++;
+  }
+
+  char* p = out;
+  *p = '-';
+  p += signbit(value) ? 1 : 0;
+
+  // All digits one place to the right, then the first one before the point:
+  writeDigits(p + precision + 2, digits, precision + 1);
+  p[0] = p[1];
+  p[1] = '.';
+  p += precision + 2;
+
+  *p++ = 'e';
+  *p++ = k < 0 ? '-' : '+';
+  unsigned exponent = k < 0 ? -k : k;
+  int exponentDigits = exponent >= 100 ? 3 : CSV_EXPONENT_DIGITS;
+  writeDigits(p + exponentDigits, exponent, exponentDigits);
+  p += exponentDigits;
+
+  return (int) (p - out);
+}
+
+uint16_t csvColumnCount(uint16_t channelCount, bool8_t cycleErrors, bool8_t blockErrors)
+{
+  return channelCount * (1 + (cycleErrors ? 1 : 0) + (blockErrors ? 1 : 0));
+}
+
+void csvWriteColumnNames(FILE* csv, uint16_t channelCount, bool8_t cycleErrors, bool8_t blockErrors)
+{
+  fprintf(csv, "Time");
+
+  for(uint16_t ch = 0; ch < channelCount; ch++)
+  {
+    fprintf(csv, ",Ch%" PRIu16, ch + 1);
+  }
+  for(uint16_t ch = 0; cycleErrors && ch < channelCount; ch++)
+  {
+    fprintf(csv, ",Ch%" PRIu16 " std err", ch + 1);
+  }
+  for(uint16_t ch = 0; blockErrors && ch < channelCount; ch++)
+  {
+    fprintf(csv, ",Ch%" PRIu16 " block std err", ch + 1);
+  }
+  fprintf(csv, "\n");
+}
+
+void csvColumns(const Accumulator_t* acc, uint64_t row, uint64_t rows, bool8_t cycleErrors, bool8_t blockErrors, float* values, uint64_t stride)
+{
+  float* column = values;
+
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++, column += stride)
+  {
+    accumulatorMeans(acc, ch, row, rows, column);
+  }
+  for(uint16_t ch = 0; cycleErrors && ch < acc->channelCount; ch++, column += stride)
+  {
+    accumulatorStdErrors(acc, ch, row, rows, BOOL8_FALSE, column);
+  }
+  for(uint16_t ch = 0; blockErrors && ch < acc->channelCount; ch++, column += stride)
+  {
+    accumulatorStdErrors(acc, ch, row, rows, BOOL8_TRUE, column);
+  }
+}
+
+void csvWriteRows(FILE* csv, const float* values, uint16_t columnCount, uint64_t stride, uint64_t row, uint64_t rows, double fs, bool8_t timeColumn)
+{
+  char buffer[CSV_BUFFER_SIZE];
+  size_t length = 0;
+  size_t rowLength = (columnCount + 1) * (CSV_MAX_FIELD_LENGTH + 1) + 2;
+
+  for(uint64_t i = 0; i < rows; i++)
+  {
+    if(length + rowLength > sizeof(buffer))
+    {
+      fwrite(buffer, 1, length, csv);
+      length = 0;
+    }
+
+    if(timeColumn)
+      length += formatExponent(buffer + length, (float) (row + i) / fs, 6);
+    for(uint16_t c = 0; c < columnCount; c++)
+    {
+      if(timeColumn || c > 0)
+        buffer[length++] = ',';
+      length += formatExponent(buffer + length, values[c * stride + i], 8); // 8 for float, 16 for double
+    }
+    buffer[length++] = ' ';
+    buffer[length++] = '\n';
+  }
+
+  fwrite(buffer, 1, length, csv);
+}
+
+void csvWriteBins(FILE* csv, const float* values, uint16_t columnCount, uint64_t stride, const Roi_t* roi, uint64_t cycleLength, double fs, bool8_t timeColumn)
+{
+  uint64_t sample;
+
+  for(uint64_t bin = 0; bin < stride; )
+  {
+    uint64_t rows = roiRun(roi, cycleLength, bin, &sample);
+    csvWriteRows(csv, values + bin, columnCount, stride, sample, rows, fs, timeColumn);
+    bin += rows;
+  }
+}
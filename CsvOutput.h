@@ -0,0 +1,35 @@
+/**
+ * CsvOutput.h
+ * @author Simon Collignon
+ *
+ * Data section of the csv files: the means of the channels, then their
+ * standard errors, one row per cycle sample.
+ */
+
+#ifndef _CSVOUTPUT_H_
+#define _CSVOUTPUT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "Roi.h"
+
+// Columns written for channelCount channels:
+uint16_t csvColumnCount(uint16_t channelCount, bool8_t cycleErrors, bool8_t blockErrors);
+
+// Write the column names line:
+void csvWriteColumnNames(FILE* csv, uint16_t channelCount, bool8_t cycleErrors, bool8_t blockErrors);
+
+// Scale samples [row, row + rows) of acc to volts, column c of the result
+// starts at values + c * stride:
+void csvColumns(const Accumulator_t* acc, uint64_t row, uint64_t rows, bool8_t cycleErrors, bool8_t blockErrors, float* values, uint64_t stride);
+
+// Write rows [row, row + rows) from columns filled by csvColumns:
+void csvWriteRows(FILE* csv, const float* values, uint16_t columnCount, uint64_t stride, uint64_t row, uint64_t rows, double fs, bool8_t timeColumn);
+
+// Write all bins of the windows of roi, columns of stride floats filled by
+// csvColumns, the time of a row is the one of its sample in the cycle:
+void csvWriteBins(FILE* csv, const float* values, uint16_t columnCount, uint64_t stride, const Roi_t* roi, uint64_t cycleLength, double fs, bool8_t timeColumn);
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * FractionalDelay.c
+ * @author Simon Collignon
+ *
+ * The taps are stored reversed, so an output sample is a dot product with
+ * contiguous input samples and the FIR kernel computes a vector of outputs
+ * per pass over the taps. Only the outputs whose taps reach beyond the ends
+ * of the cycle are computed apart, on the clamped input.
+ *
+ * The cycles are written into separate buffers, so the samples of every
+ * channel are split in equal ranges over the threads regardless of cycle
+ * boundaries.
+ */
+
+#include "FractionalDelay.h"
+#include <math.h>
+
+// Below this many samples per thread, waking the threads costs more than it saves:
+#define FRACTIONAL_DELAY_MIN_THREAD_SAMPLES 65536
+
+typedef struct
+{
+  const FractionalDelay_t* fd;
+  const Kernels_t* kernels;
+  float** dst;
+  float** src;
+  uint64_t length;
+  uint64_t cycleCount;
+  uint64_t total;          // samples of all channels
+  const double* delays;
+  unsigned threadCount;
+} DelayJob_t;
+
+// Tap of the sinc centered on the input sample that is not delayed:
+#define FRACTIONAL_DELAY_CENTER (FRACTIONAL_DELAY_TAPS / 2 - 1)
+
+void fractionalDelayInit(FractionalDelay_t* fd)
+{
+  for(int p = 0; p < FRACTIONAL_DELAY_PHASES; p++)
+  {
+    double mu = (double) p / FRACTIONAL_DELAY_PHASES;
+    double sum = 0;
+    double taps[FRACTIONAL_DELAY_TAPS];
+
+    for(int k = 0; k < FRACTIONAL_DELAY_TAPS; k++)
+    {
+      double x = k - FRACTIONAL_DELAY_CENTER - mu;
+      double sinc = x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+      // Blackman window over the taps, shifted along with the sinc:
+      double w = 2 * M_PI * (x + FRACTIONAL_DELAY_TAPS / 2.0) / FRACTIONAL_DELAY_TAPS;
+      taps[k] = sinc * (0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w));
+      sum += taps[k];
+    }
+
+    // Unity gain at DC:
+    for(int k = 0; k < FRACTIONAL_DELAY_TAPS; k++)
+    {
+      fd->taps[p][FRACTIONAL_DELAY_TAPS - 1 - k] = (float) (taps[k] / sum);
+    }
+  }
+}
+
+// Output i, reading src[i + base + k] clamped to the cycle:
+static float fractionalDelayEdge(const float* taps, const float* src, int64_t length, int64_t i, int64_t base)
+{
+  float sum = 0;
+  for(int k = 0; k < FRACTIONAL_DELAY_TAPS; k++)
+  {
+    int64_t j = i + base + k;
+    sum += taps[k] * src[j < 0 ? 0 : (j >= length ? length - 1 : j)];
+  }
+  return sum;
+}
+
+void fractionalDelayApply(const FractionalDelay_t* fd, const Kernels_t* kernels, float* dst, const float* src, uint64_t length, double delay, uint64_t start, uint64_t count)
+{
+  // Integer part and nearest of the fractional steps:
+  double whole = floor(delay);
+  int p = (int) lround((delay - whole) * FRACTIONAL_DELAY_PHASES);
+  int64_t shift = (int64_t) whole;
+  if(p == FRACTIONAL_DELAY_PHASES)
+  {
+    p = 0;
+    shift++;
+  }
+
+  // dst[i] = sum of taps[k] * src[i + base + k], all in range on [first, last):
+  const float* taps = fd->taps[p];
+  int64_t n = (int64_t) length;
+  int64_t begin = (int64_t) start;
+  int64_t end = (int64_t) (start + count);
+  int64_t base = FRACTIONAL_DELAY_CENTER - (FRACTIONAL_DELAY_TAPS - 1) - shift;
+  int64_t first = -base < begin ? begin : (-base > end ? end : -base);
+  int64_t last = n - (FRACTIONAL_DELAY_TAPS - 1) - base;
+  last = last < first ? first : (last > end ? end : last);
+
+  for(int64_t i = begin; i < first; i++)
+  {
+    dst[i] = fractionalDelayEdge(taps, src, n, i, base);
+  }
+
+  if(last > first)
+    kernels->firFloat(dst + first, src + first + base, taps, FRACTIONAL_DELAY_TAPS, (uint64_t) (last - first));
+
+  for(int64_t i = last; i < end; i++)
+  {
+    dst[i] = fractionalDelayEdge(taps, src, n, i, base);
+  }
+}
+
+static void fractionalDelayTask(void* arg, unsigned index)
+{
+  const DelayJob_t* job = arg;
+  uint64_t perChannel = job->cycleCount * job->length;
+  uint64_t first = job->total * index / job->threadCount;
+  uint64_t last = job->total * (index + 1) / job->threadCount;
+
+  // Samples [first, last) of the channels one after the other, cut at cycle ends:
+  while(first < last)
+  {
+    uint16_t ch = (uint16_t) (first / perChannel);
+    uint64_t cycle = first % perChannel / job->length;
+    uint64_t start = first % job->length;
+    uint64_t count = job->length - start < last - first ? job->length - start : last - first;
+    uint64_t offset = cycle * job->length;
+
+    fractionalDelayApply(job->fd, job->kernels, job->dst[ch] + offset, job->src[ch] + offset, job->length, job->delays[cycle], start, count);
+    first += count;
+  }
+}
+
+void fractionalDelayApplyCycles(const FractionalDelay_t* fd, const Kernels_t* kernels, float** dst, float** src, uint16_t channelCount, uint64_t length, uint64_t cycleCount, const double* delays, ParallelPool_t* pool)
+{
+  DelayJob_t job = {fd, kernels, dst, src, length, cycleCount, channelCount * cycleCount * length, delays, 1};
+  uint64_t maxThreadCount = job.total / FRACTIONAL_DELAY_MIN_THREAD_SAMPLES;
+  unsigned threadCount = parallelPoolThreadCount(pool);
+
+  if(maxThreadCount < threadCount)
+    threadCount = (unsigned) maxThreadCount;
+  if(threadCount > 1)
+    job.threadCount = threadCount;
+
+  parallelPoolRun(pool, fractionalDelayTask, &job, job.threadCount);
+}
@@ -0,0 +1,36 @@
+/**
+ * FractionalDelay.h
+ * @author Simon Collignon
+ *
+ * Delay of a cycle by a fraction of a sample with a windowed sinc FIR, the
+ * taps of every fractional part are computed once in a polyphase table.
+ */
+
+#ifndef _FRACTIONALDELAY_H_
+#define _FRACTIONALDELAY_H_
+
+#include <stdint.h>
+#include "Kernels.h"
+#include "Parallel.h"
+
+#define FRACTIONAL_DELAY_TAPS 16    // taps per phase, flat to about 0.4 fs
+#define FRACTIONAL_DELAY_PHASES 64  // fractional delay steps of 1/64 sample
+
+typedef struct
+{
+  float taps[FRACTIONAL_DELAY_PHASES][FRACTIONAL_DELAY_TAPS];
+} FractionalDelay_t;
+
+void fractionalDelayInit(FractionalDelay_t* fd);
+
+// dst[n] = src(n - delay) for n in [start, start + count) of a cycle of
+// length samples, delay in samples of either sign, src is extended with its
+// first and last sample beyond its ends:
+void fractionalDelayApply(const FractionalDelay_t* fd, const Kernels_t* kernels, float* dst, const float* src, uint64_t length, double delay, uint64_t start, uint64_t count);
+
+// Delay cycle c of cycleCount cycles of length samples by delays[c], on every
+// channel, from src into dst, one float* per channel. The samples are split
+// in equal ranges over the threads of pool, which may be NULL:
+void fractionalDelayApplyCycles(const FractionalDelay_t* fd, const Kernels_t* kernels, float** dst, float** src, uint16_t channelCount, uint64_t length, uint64_t cycleCount, const double* delays, ParallelPool_t* pool);
+
+#endif
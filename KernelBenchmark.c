@@ -0,0 +1,216 @@
+/**
+ * KernelBenchmark.c
+ * @author Simon Collignon
+ *
+ * This code measures the throughput of the accumulator kernels of every
+ * instruction set the CPU supports, on blocks of 50 MSa by default, next to
+ * memcpy as the memory bandwidth reference, then the phase correction of
+ * two channels on every core. No oscilloscope is needed.
+ *
+ *   KernelBenchmark [samples per block]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "FractionalDelay.h"
+#include "Kernels.h"
+#include "Parallel.h"
+#include "PhaseCorrection.h"
+#include "Transfer.h" // for TRANSFER_DEFAULT_CHUNK_LENGTH
+#include "Utils.h"
+
+#define REPEAT_COUNT 5
+#define CYCLE_LENGTH 10000
+
+typedef struct
+{
+  int16_t* codes;  // raw record
+  int32_t* sum32;  // record or cycle sums
+  int64_t* sum64;  // flushed sums, its memory also holds the float buffers
+  uint64_t length;
+} Buffers_t;
+
+typedef enum
+{
+  BENCH_COPY,
+  BENCH_ADD_FLOAT,
+  BENCH_ADD_RECORD,
+  BENCH_FOLD_CYCLES,
+  BENCH_FOLD_SQUARES,
+  BENCH_FOLD_CHECK,
+  BENCH_FLUSH,
+  BENCH_NORMALIZE,
+  BENCH_DELAY,
+  BENCH_COUNT
+} Bench_t;
+
+static const char* BenchNames[BENCH_COUNT] = {"memcpy", "add float", "add int16 record", "fold int16 cycles", "fold int16 + squares", "fold int16 + check", "flush int32 to int64", "normalize int32", "fractional delay"};
+
+// Bytes read and written per sample:
+static const double BenchBytes[BENCH_COUNT] = {8, 12, 10, 2, 2, 2, 20, 8, 8};
+
+static FractionalDelay_t Delay;
+
+static void runBench(Bench_t bench, const Kernels_t* k, Buffers_t* b)
+{
+  float* floats = (float*) b->sum64;
+
+  switch(bench)
+  {
+    case BENCH_COPY:
+      memcpy(b->sum64, b->sum32, sizeof(int32_t) * b->length);
+      break;
+    case BENCH_ADD_FLOAT:
+      k->addFloat(floats, floats + b->length, b->length);
+      break;
+    case BENCH_ADD_RECORD:
+      k->addInt16To32(b->sum32, b->codes, b->length);
+      break;
+    case BENCH_FOLD_CYCLES:
+      for(uint64_t i = 0; i + CYCLE_LENGTH <= b->length; i += CYCLE_LENGTH)
+      {
+        k->addInt16To32(b->sum32, b->codes + i, CYCLE_LENGTH);
+      }
+      break;
+    case BENCH_FOLD_SQUARES:
+      for(uint64_t i = 0; i + CYCLE_LENGTH <= b->length; i += CYCLE_LENGTH)
+      {
+        k->addSquaresInt16To32(b->sum32, (double*) b->sum64, b->codes + i, CYCLE_LENGTH);
+      }
+      break;
+    case BENCH_FOLD_CHECK:
+      for(uint64_t i = 0; i + CYCLE_LENGTH <= b->length; i += CYCLE_LENGTH)
+      {
+        int32_t range[3] = {INT32_MAX, INT32_MIN, 0};
+        k->addCheckInt16To32(b->sum32, NULL, b->codes + i, CYCLE_LENGTH, range);
+      }
+      break;
+    case BENCH_FLUSH:
+      k->addInt32To64(b->sum64, b->sum32, b->length);
+      break;
+    case BENCH_NORMALIZE:
+      k->normalizeInt32(floats, b->sum32, b->length, 1000, 0, 1.0 / 2048);
+      break;
+    case BENCH_DELAY:
+      for(uint64_t i = 0; i + CYCLE_LENGTH <= b->length; i += CYCLE_LENGTH)
+      {
+        fractionalDelayApply(&Delay, k, floats + b->length + i, floats + i, CYCLE_LENGTH, 0.37, 0, CYCLE_LENGTH);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Phase correction of a block of two channels in the chunks of a transfer,
+// the reference tone on the first one, best MSa/s per channel:
+static double benchPhaseCorrection(Buffers_t* b, unsigned threadCount)
+{
+  float* channels[2] = {(float*) b->sum64, (float*) b->sum64 + b->length};
+  uint64_t chunkLength = (TRANSFER_DEFAULT_CHUNK_LENGTH + CYCLE_LENGTH - 1) / CYCLE_LENGTH * CYCLE_LENGTH;
+  PhaseCorrection_t pc;
+  double best = 0;
+
+  if(!phaseCorrectionInit(&pc, 2, CYCLE_LENGTH, chunkLength, 0, 0.1, 0, threadCount))
+    return 0;
+
+  for(int r = 0; r < REPEAT_COUNT; r++)
+  {
+    double start = monotonicSeconds();
+
+    for(uint64_t position = 0; position + chunkLength <= b->length; position += chunkLength)
+    {
+      float* chunk[2] = {channels[0] + position, channels[1] + position};
+      phaseCorrectionApply(&pc, chunk, position, chunkLength);
+    }
+
+    double elapsed = monotonicSeconds() - start;
+    if(best == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  phaseCorrectionFree(&pc);
+  return b->length / chunkLength * chunkLength / best * 1e-6;
+}
+
+int main(int argc, char* argv[])
+{
+  int status = EXIT_SUCCESS;
+  Buffers_t b;
+
+  b.length = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+  b.codes = malloc(sizeof(int16_t) * b.length);
+  b.sum32 = malloc(sizeof(int32_t) * b.length);
+  b.sum64 = malloc(sizeof(int64_t) * b.length);
+
+  if(b.length > 0 && b.codes && b.sum32 && b.sum64)
+  {
+    fractionalDelayInit(&Delay);
+
+    // Touch every page before timing, with values like a 12 bit scope's:
+    for(uint64_t i = 0; i < b.length; i++)
+    {
+      b.codes[i] = (int16_t) ((i * 2654435761u) % 4096) - 2048;
+      b.sum32[i] = b.codes[i];
+      ((float*) b.sum64)[2 * i] = 1.0f;
+      ((float*) b.sum64)[2 * i + 1] = 1.0f;
+    }
+
+    printf("%" PRIu64 " samples per block, best of %d" NEWLINE, b.length, REPEAT_COUNT);
+    printf("%-22s %-8s %10s %10s" NEWLINE, "kernel", "set", "MSa/s", "GB/s");
+
+    for(int bench = 0; bench < BENCH_COUNT; bench++)
+    {
+      const Kernels_t* k;
+
+      for(unsigned index = 0; (k = kernelsAvailable(index)); index++)
+      {
+        double best = 0;
+
+        for(int r = 0; r < REPEAT_COUNT; r++)
+        {
+          double start = monotonicSeconds();
+          runBench(bench, k, &b);
+          double elapsed = monotonicSeconds() - start;
+
+          if(best == 0 || elapsed < best)
+            best = elapsed;
+        }
+
+        printf("%-22s %-8s %10.1f %10.2f" NEWLINE, BenchNames[bench], bench == BENCH_COPY ? "libc" : k->name,
+          b.length / best * 1e-6, b.length * BenchBytes[bench] / best * 1e-9);
+
+        // memcpy doesn't depend on the kernel set:
+        if(bench == BENCH_COPY)
+          break;
+      }
+    }
+
+    // A reference tone whose phase wanders from cycle to cycle, on both channels:
+    float* tone = (float*) b.sum64;
+    for(uint64_t i = 0; i < 2 * b.length; i++)
+    {
+      uint64_t n = i % b.length;
+      tone[i] = (float) cos(0.2 * M_PI * n + 0.1 * (n / CYCLE_LENGTH % 7));
+    }
+
+    unsigned coreCount = parallelCoreCount();
+    printf("phase correction, 2 channels: %.1f MSa/s per channel on 1 thread, %.1f on %u" NEWLINE,
+      benchPhaseCorrection(&b, 1), benchPhaseCorrection(&b, coreCount), coreCount);
+  }
+  else
+  {
+    fprintf(stderr, "Couldn't allocate the benchmark buffers!" NEWLINE);
+    status = EXIT_FAILURE;
+  }
+
+  free(b.codes);
+  free(b.sum32);
+  free(b.sum64);
+
+  return status;
+}
@@ -0,0 +1,1114 @@
+/**
+ * Kernels.c
+ * @author Simon Collignon
+ *
+ * Each instruction set gets its own functions compiled with a target
+ * attribute, so the file builds without -march and only the selected set is
+ * ever executed. Every kernel handles the samples that don't fill a vector
+ * with the scalar loop.
+ */
+
+#include "Kernels.h"
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define KERNELS_X86
+#  include <immintrin.h>
+#endif
+
+// sum[i] += src[i], widening the source type to the sum type:
+#define DEFINE_ADD_SCALAR(name, sumType, srcType) \
+  static void name(sumType* restrict sum, const srcType* restrict src, uint64_t count) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      sum[i] += src[i]; \
+    } \
+  }
+
+DEFINE_ADD_SCALAR(addFloatScalar, float, float)
+DEFINE_ADD_SCALAR(addInt8To32Scalar, int32_t, int8_t)
+DEFINE_ADD_SCALAR(addInt16To32Scalar, int32_t, int16_t)
+DEFINE_ADD_SCALAR(addInt32To32Scalar, int32_t, int32_t)
+DEFINE_ADD_SCALAR(addInt32To64Scalar, int64_t, int32_t)
+DEFINE_ADD_SCALAR(addFloatToDoubleScalar, double, float)
+
+// sum[i] += src[i] and squares[i] += src[i]^2:
+#define DEFINE_ADD_SQUARES_SCALAR(name, sumType, srcType) \
+  static void name(sumType* restrict sum, double* restrict squares, const srcType* restrict src, uint64_t count) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      sum[i] += src[i]; \
+      squares[i] += (double) src[i] * src[i]; \
+    } \
+  }
+
+DEFINE_ADD_SQUARES_SCALAR(addSquaresFloatScalar, float, float)
+DEFINE_ADD_SQUARES_SCALAR(addSquaresInt8To32Scalar, int32_t, int8_t)
+DEFINE_ADD_SQUARES_SCALAR(addSquaresInt16To32Scalar, int32_t, int16_t)
+
+// The same, squares may be NULL, and range[0] and range[1] lowered and raised
+// to the smallest and largest sample, range[2] raised to the largest step
+// between neighbouring samples:
+#define DEFINE_ADD_CHECK_SCALAR(name, sumType, srcType, rangeType) \
+  static void name(sumType* restrict sum, double* restrict squares, const srcType* restrict src, uint64_t count, rangeType* range) \
+  { \
+    for(uint64_t i = 0; i < count; i++) \
+    { \
+      rangeType x = src[i]; \
+      sum[i] += src[i]; \
+      if(squares) \
+        squares[i] += (double) src[i] * src[i]; \
+      range[0] = x < range[0] ? x : range[0]; \
+      range[1] = x > range[1] ? x : range[1]; \
+      if(i > 0) \
+      { \
+        rangeType step = x > src[i - 1] ? x - src[i - 1] : src[i - 1] - x; \
+        range[2] = step > range[2] ? step : range[2]; \
+      } \
+    } \
+  }
+
+DEFINE_ADD_CHECK_SCALAR(addCheckInt8To32Scalar, int32_t, int8_t, int32_t)
+DEFINE_ADD_CHECK_SCALAR(addCheckInt16To32Scalar, int32_t, int16_t, int32_t)
+
+// Raise range[2] to the step between the last sample of a vector loop and
+// the first one of the scalar loop after it:
+#define DEFINE_CHECK_STEP(name, srcType, rangeType) \
+  static inline void name(rangeType* range, srcType a, srcType b) \
+  { \
+    rangeType step = a > b ? (rangeType) a - b : (rangeType) b - a; \
+    range[2] = step > range[2] ? step : range[2]; \
+  }
+
+DEFINE_CHECK_STEP(checkStepFloat, float, float)
+DEFINE_CHECK_STEP(checkStepInt8, int8_t, int32_t)
+DEFINE_CHECK_STEP(checkStepInt16, int16_t, int32_t)
+
+// range[0] and range[1] lowered and raised to the smallest and largest
+// sample, range[2] raised to the largest step between neighbouring samples,
+// nothing is added:
+static void checkFloatScalar(const float* src, uint64_t count, float* range)
+{
+  for(uint64_t i = 0; i < count; i++)
+  {
+    float x = src[i];
+    range[0] = x < range[0] ? x : range[0];
+    range[1] = x > range[1] ? x : range[1];
+    if(i > 0)
+      checkStepFloat(range, src[i - 1], x);
+  }
+}
+
+static void normalizeInt32Scalar(float* restrict mean, const int32_t* restrict sum, uint64_t length, double count, double zero, double scale)
+{
+  for(uint64_t i = 0; i < length; i++)
+  {
+    mean[i] = (float) (((double) sum[i] / count - zero) * scale);
+  }
+}
+
+static void firFloatScalar(float* restrict dst, const float* restrict src, const float* restrict taps, unsigned tapCount, uint64_t count)
+{
+  for(uint64_t i = 0; i < count; i++)
+  {
+    float sum = 0;
+    for(unsigned k = 0; k < tapCount; k++)
+    {
+      sum += taps[k] * src[i + k];
+    }
+    dst[i] = sum;
+  }
+}
+
+static double dotFloatScalar(const float* x, const float* y, uint64_t count)
+{
+  double sum = 0;
+  for(uint64_t i = 0; i < count; i++)
+  {
+    sum += (double) x[i] * y[i];
+  }
+  return sum;
+}
+
+static const Kernels_t KernelsScalar = {
+  "scalar",
+  addFloatScalar,
+  addInt8To32Scalar,
+  addInt16To32Scalar,
+  addInt32To32Scalar,
+  addInt32To64Scalar,
+  addFloatToDoubleScalar,
+  addSquaresFloatScalar,
+  addSquaresInt8To32Scalar,
+  addSquaresInt16To32Scalar,
+  checkFloatScalar,
+  addCheckInt8To32Scalar,
+  addCheckInt16To32Scalar,
+  normalizeInt32Scalar,
+  firFloatScalar,
+  dotFloatScalar
+};
+
+#ifdef KERNELS_X86
+
+// SSE2, sign extension by unpacking a value with itself and shifting back:
+
+__attribute__((target("sse2")))
+static void addFloatSse2(float* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_loadu_ps(src + i)));
+  }
+  addFloatScalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addInt8To32Sse2(int32_t* sum, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+    _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+    _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+    _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+  }
+  addInt8To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addInt16To32Sse2(int32_t* sum, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+    _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+  }
+  addInt16To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addInt32To32Sse2(int32_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_loadu_si128((const __m128i*) (src + i))));
+  }
+  addInt32To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addInt32To64Sse2(int64_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i sign = _mm_srai_epi32(x, 31);
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s + 0, _mm_add_epi64(_mm_loadu_si128(s + 0), _mm_unpacklo_epi32(x, sign)));
+    _mm_storeu_si128(s + 1, _mm_add_epi64(_mm_loadu_si128(s + 1), _mm_unpackhi_epi32(x, sign)));
+  }
+  addInt32To64Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addFloatToDoubleSse2(double* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(src + i);
+    _mm_storeu_pd(sum + i, _mm_add_pd(_mm_loadu_pd(sum + i), _mm_cvtps_pd(x)));
+    _mm_storeu_pd(sum + i + 2, _mm_add_pd(_mm_loadu_pd(sum + i + 2), _mm_cvtps_pd(_mm_movehl_ps(x, x))));
+  }
+  addFloatToDoubleScalar(sum + i, src + i, count - i);
+}
+
+// squares[0..3] += x^2 for 4 int32 x:
+__attribute__((target("sse2")))
+static inline void addSquaresEpi32Sse2(double* squares, __m128i x)
+{
+  __m128d lo = _mm_cvtepi32_pd(x);
+  __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(x, 0xee));
+  _mm_storeu_pd(squares, _mm_add_pd(_mm_loadu_pd(squares), _mm_mul_pd(lo, lo)));
+  _mm_storeu_pd(squares + 2, _mm_add_pd(_mm_loadu_pd(squares + 2), _mm_mul_pd(hi, hi)));
+}
+
+__attribute__((target("sse2")))
+static void addSquaresFloatSse2(float* sum, double* squares, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(src + i);
+    __m128d lo = _mm_cvtps_pd(x);
+    __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+    _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), x));
+    _mm_storeu_pd(squares + i, _mm_add_pd(_mm_loadu_pd(squares + i), _mm_mul_pd(lo, lo)));
+    _mm_storeu_pd(squares + i + 2, _mm_add_pd(_mm_loadu_pd(squares + i + 2), _mm_mul_pd(hi, hi)));
+  }
+  addSquaresFloatScalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addSquaresInt8To32Sse2(int32_t* sum, double* squares, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+    __m128i v[4] = {
+      _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16),
+      _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16),
+      _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16),
+      _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)
+    };
+    __m128i* s = (__m128i*) (sum + i);
+    for(int k = 0; k < 4; k++)
+    {
+      _mm_storeu_si128(s + k, _mm_add_epi32(_mm_loadu_si128(s + k), v[k]));
+      addSquaresEpi32Sse2(squares + i + 4 * k, v[k]);
+    }
+  }
+  addSquaresInt8To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void addSquaresInt16To32Sse2(int32_t* sum, double* squares, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), lo));
+    _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), hi));
+    addSquaresEpi32Sse2(squares + i, lo);
+    addSquaresEpi32Sse2(squares + i + 4, hi);
+  }
+  addSquaresInt16To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+// Lower and raise range[0..2] by the lanes of 8 int16 minima, maxima and
+// steps, the steps biased as by stepEpi16Sse2:
+__attribute__((target("sse2")))
+static inline void checkRangeEpi16Sse2(int32_t* range, __m128i lo, __m128i hi, __m128i step)
+{
+  int16_t v[3][8];
+  step = _mm_xor_si128(step, _mm_set1_epi16(INT16_MIN));
+  _mm_storeu_si128((__m128i*) v[0], lo);
+  _mm_storeu_si128((__m128i*) v[1], hi);
+  _mm_storeu_si128((__m128i*) v[2], step);
+  for(int k = 0; k < 8; k++)
+  {
+    range[0] = v[0][k] < range[0] ? v[0][k] : range[0];
+    range[1] = v[1][k] > range[1] ? v[1][k] : range[1];
+    range[2] = (uint16_t) v[2][k] > range[2] ? (uint16_t) v[2][k] : range[2];
+  }
+}
+
+// |x - p| of int16 lanes, up to 65535 as uint16 with the sign bit flipped so
+// the steps compare with the signed max of SSE2. The inputs are biased the
+// same way to subtract them unsigned and saturated:
+__attribute__((target("sse2")))
+static inline __m128i stepEpi16Sse2(__m128i x, __m128i p)
+{
+  __m128i bias = _mm_set1_epi16(INT16_MIN);
+  x = _mm_xor_si128(x, bias);
+  p = _mm_xor_si128(p, bias);
+  return _mm_xor_si128(_mm_or_si128(_mm_subs_epu16(x, p), _mm_subs_epu16(p, x)), bias);
+}
+
+// The vector loops start at the second sample, so every lane has the sample
+// before it in the same call:
+
+__attribute__((target("sse2")))
+static void checkFloatSse2(const float* src, uint64_t count, float* range)
+{
+  if(count == 0)
+    return;
+
+  checkFloatScalar(src, 1, range);
+  __m128 lo = _mm_set1_ps(src[0]);
+  __m128 hi = lo;
+  __m128 step = _mm_setzero_ps();
+  __m128 sign = _mm_set1_ps(-0.0f);
+  uint64_t i = 1;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(src + i);
+    lo = _mm_min_ps(lo, x);
+    hi = _mm_max_ps(hi, x);
+    step = _mm_max_ps(step, _mm_andnot_ps(sign, _mm_sub_ps(x, _mm_loadu_ps(src + i - 1))));
+  }
+
+  float v[3][4];
+  _mm_storeu_ps(v[0], lo);
+  _mm_storeu_ps(v[1], hi);
+  _mm_storeu_ps(v[2], step);
+  for(int k = 0; k < 4; k++)
+  {
+    range[0] = v[0][k] < range[0] ? v[0][k] : range[0];
+    range[1] = v[1][k] > range[1] ? v[1][k] : range[1];
+    range[2] = v[2][k] > range[2] ? v[2][k] : range[2];
+  }
+
+  if(i < count)
+  {
+    checkStepFloat(range, src[i - 1], src[i]);
+    checkFloatScalar(src + i, count - i, range);
+  }
+}
+
+__attribute__((target("sse2")))
+static void addCheckInt8To32Sse2(int32_t* sum, double* squares, const int8_t* src, uint64_t count, int32_t* range)
+{
+  if(count == 0)
+    return;
+
+  addCheckInt8To32Scalar(sum, squares, src, 1, range);
+  __m128i lo = _mm_set1_epi16(src[0]);
+  __m128i hi = lo;
+  __m128i step = _mm_set1_epi16(INT16_MIN); // 0, biased
+  uint64_t i = 1;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i p = _mm_loadu_si128((const __m128i*) (src + i - 1));
+    __m128i xlo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+    __m128i xhi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+    lo = _mm_min_epi16(lo, _mm_min_epi16(xlo, xhi));
+    hi = _mm_max_epi16(hi, _mm_max_epi16(xlo, xhi));
+    step = _mm_max_epi16(step, stepEpi16Sse2(xlo, _mm_srai_epi16(_mm_unpacklo_epi8(p, p), 8)));
+    step = _mm_max_epi16(step, stepEpi16Sse2(xhi, _mm_srai_epi16(_mm_unpackhi_epi8(p, p), 8)));
+    __m128i v[4] = {
+      _mm_srai_epi32(_mm_unpacklo_epi16(xlo, xlo), 16),
+      _mm_srai_epi32(_mm_unpackhi_epi16(xlo, xlo), 16),
+      _mm_srai_epi32(_mm_unpacklo_epi16(xhi, xhi), 16),
+      _mm_srai_epi32(_mm_unpackhi_epi16(xhi, xhi), 16)
+    };
+    __m128i* s = (__m128i*) (sum + i);
+    for(int k = 0; k < 4; k++)
+    {
+      _mm_storeu_si128(s + k, _mm_add_epi32(_mm_loadu_si128(s + k), v[k]));
+      if(squares)
+        addSquaresEpi32Sse2(squares + i + 4 * k, v[k]);
+    }
+  }
+  checkRangeEpi16Sse2(range, lo, hi, step);
+
+  if(i < count)
+  {
+    checkStepInt8(range, src[i - 1], src[i]);
+    addCheckInt8To32Scalar(sum + i, squares ? squares + i : NULL, src + i, count - i, range);
+  }
+}
+
+__attribute__((target("sse2")))
+static void addCheckInt16To32Sse2(int32_t* sum, double* squares, const int16_t* src, uint64_t count, int32_t* range)
+{
+  if(count == 0)
+    return;
+
+  addCheckInt16To32Scalar(sum, squares, src, 1, range);
+  __m128i lo = _mm_set1_epi16(src[0]);
+  __m128i hi = lo;
+  __m128i step = _mm_set1_epi16(INT16_MIN); // 0, biased
+  uint64_t i = 1;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    lo = _mm_min_epi16(lo, x);
+    hi = _mm_max_epi16(hi, x);
+    step = _mm_max_epi16(step, stepEpi16Sse2(x, _mm_loadu_si128((const __m128i*) (src + i - 1))));
+    __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    __m128i* s = (__m128i*) (sum + i);
+    _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), a));
+    _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), b));
+    if(squares)
+    {
+      addSquaresEpi32Sse2(squares + i, a);
+      addSquaresEpi32Sse2(squares + i + 4, b);
+    }
+  }
+  checkRangeEpi16Sse2(range, lo, hi, step);
+
+  if(i < count)
+  {
+    checkStepInt16(range, src[i - 1], src[i]);
+    addCheckInt16To32Scalar(sum + i, squares ? squares + i : NULL, src + i, count - i, range);
+  }
+}
+
+__attribute__((target("sse2")))
+static void normalizeInt32Sse2(float* mean, const int32_t* sum, uint64_t length, double count, double zero, double scale)
+{
+  __m128d c = _mm_set1_pd(count);
+  __m128d z = _mm_set1_pd(zero);
+  __m128d k = _mm_set1_pd(scale);
+  uint64_t i = 0;
+  for(; i + 4 <= length; i += 4)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (sum + i));
+    __m128d lo = _mm_mul_pd(_mm_sub_pd(_mm_div_pd(_mm_cvtepi32_pd(x), c), z), k);
+    __m128d hi = _mm_mul_pd(_mm_sub_pd(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(x, 0xee)), c), z), k);
+    _mm_storeu_ps(mean + i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+  }
+  normalizeInt32Scalar(mean + i, sum + i, length - i, count, zero, scale);
+}
+
+__attribute__((target("sse2")))
+static void firFloatSse2(float* dst, const float* src, const float* taps, unsigned tapCount, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 sum = _mm_setzero_ps();
+    for(unsigned k = 0; k < tapCount; k++)
+    {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps[k]), _mm_loadu_ps(src + i + k)));
+    }
+    _mm_storeu_ps(dst + i, sum);
+  }
+  firFloatScalar(dst + i, src + i, taps, tapCount, count - i);
+}
+
+__attribute__((target("sse2")))
+static double dotFloatSse2(const float* x, const float* y, uint64_t count)
+{
+  __m128d lo = _mm_setzero_pd();
+  __m128d hi = _mm_setzero_pd();
+  uint64_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 p = _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i));
+    lo = _mm_add_pd(lo, _mm_cvtps_pd(p));
+    hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(p, p)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(lo, hi));
+  return lanes[0] + lanes[1] + dotFloatScalar(x + i, y + i, count - i);
+}
+
+static const Kernels_t KernelsSse2 = {
+  "sse2",
+  addFloatSse2,
+  addInt8To32Sse2,
+  addInt16To32Sse2,
+  addInt32To32Sse2,
+  addInt32To64Sse2,
+  addFloatToDoubleSse2,
+  addSquaresFloatSse2,
+  addSquaresInt8To32Sse2,
+  addSquaresInt16To32Sse2,
+  checkFloatSse2,
+  addCheckInt8To32Sse2,
+  addCheckInt16To32Sse2,
+  normalizeInt32Sse2,
+  firFloatSse2,
+  dotFloatSse2
+};
+
+// AVX2, sign extension with vpmovsx:
+
+__attribute__((target("avx2")))
+static void addFloatAvx2(float* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_loadu_ps(src + i)));
+  }
+  addFloatScalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addInt8To32Avx2(int32_t* sum, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s + 0, _mm256_add_epi32(_mm256_loadu_si256(s + 0), _mm256_cvtepi8_epi32(x)));
+    _mm256_storeu_si256(s + 1, _mm256_add_epi32(_mm256_loadu_si256(s + 1), _mm256_cvtepi8_epi32(_mm_srli_si128(x, 8))));
+  }
+  addInt8To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addInt16To32Avx2(int32_t* sum, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s + 0, _mm256_add_epi32(_mm256_loadu_si256(s + 0), _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i)))));
+    _mm256_storeu_si256(s + 1, _mm256_add_epi32(_mm256_loadu_si256(s + 1), _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i + 8)))));
+  }
+  addInt16To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addInt32To32Avx2(int32_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), _mm256_loadu_si256((const __m256i*) (src + i))));
+  }
+  addInt32To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addInt32To64Avx2(int64_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s + 0, _mm256_add_epi64(_mm256_loadu_si256(s + 0), _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) (src + i)))));
+    _mm256_storeu_si256(s + 1, _mm256_add_epi64(_mm256_loadu_si256(s + 1), _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) (src + i + 4)))));
+  }
+  addInt32To64Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addFloatToDoubleAvx2(double* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), _mm256_cvtps_pd(_mm_loadu_ps(src + i))));
+    _mm256_storeu_pd(sum + i + 4, _mm256_add_pd(_mm256_loadu_pd(sum + i + 4), _mm256_cvtps_pd(_mm_loadu_ps(src + i + 4))));
+  }
+  addFloatToDoubleScalar(sum + i, src + i, count - i);
+}
+
+// squares[0..7] += x^2 for 8 int32 x:
+__attribute__((target("avx2")))
+static inline void addSquaresEpi32Avx2(double* squares, __m256i x)
+{
+  __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+  __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+  _mm256_storeu_pd(squares, _mm256_add_pd(_mm256_loadu_pd(squares), _mm256_mul_pd(lo, lo)));
+  _mm256_storeu_pd(squares + 4, _mm256_add_pd(_mm256_loadu_pd(squares + 4), _mm256_mul_pd(hi, hi)));
+}
+
+__attribute__((target("avx2")))
+static void addSquaresFloatAvx2(float* sum, double* squares, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(src + i);
+    __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+    __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+    _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), x));
+    _mm256_storeu_pd(squares + i, _mm256_add_pd(_mm256_loadu_pd(squares + i), _mm256_mul_pd(lo, lo)));
+    _mm256_storeu_pd(squares + i + 4, _mm256_add_pd(_mm256_loadu_pd(squares + i + 4), _mm256_mul_pd(hi, hi)));
+  }
+  addSquaresFloatScalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addSquaresInt8To32Avx2(int32_t* sum, double* squares, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i x = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*) (src + i)));
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), x));
+    addSquaresEpi32Avx2(squares + i, x);
+  }
+  addSquaresInt8To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void addSquaresInt16To32Avx2(int32_t* sum, double* squares, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+    __m256i* s = (__m256i*) (sum + i);
+    _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), x));
+    addSquaresEpi32Avx2(squares + i, x);
+  }
+  addSquaresInt16To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+// Lower and raise range[0..2] by the lanes of 8 int32 minima, maxima and steps:
+__attribute__((target("avx2")))
+static inline void checkRangeEpi32Avx2(int32_t* range, __m256i lo, __m256i hi, __m256i step)
+{
+  int32_t v[3][8];
+  _mm256_storeu_si256((__m256i*) v[0], lo);
+  _mm256_storeu_si256((__m256i*) v[1], hi);
+  _mm256_storeu_si256((__m256i*) v[2], step);
+  for(int k = 0; k < 8; k++)
+  {
+    range[0] = v[0][k] < range[0] ? v[0][k] : range[0];
+    range[1] = v[1][k] > range[1] ? v[1][k] : range[1];
+    range[2] = v[2][k] > range[2] ? v[2][k] : range[2];
+  }
+}
+
+__attribute__((target("avx2")))
+static void checkFloatAvx2(const float* src, uint64_t count, float* range)
+{
+  if(count == 0)
+    return;
+
+  checkFloatScalar(src, 1, range);
+  __m256 lo = _mm256_set1_ps(src[0]);
+  __m256 hi = lo;
+  __m256 step = _mm256_setzero_ps();
+  __m256 sign = _mm256_set1_ps(-0.0f);
+  uint64_t i = 1;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(src + i);
+    lo = _mm256_min_ps(lo, x);
+    hi = _mm256_max_ps(hi, x);
+    step = _mm256_max_ps(step, _mm256_andnot_ps(sign, _mm256_sub_ps(x, _mm256_loadu_ps(src + i - 1))));
+  }
+
+  float v[3][8];
+  _mm256_storeu_ps(v[0], lo);
+  _mm256_storeu_ps(v[1], hi);
+  _mm256_storeu_ps(v[2], step);
+  for(int k = 0; k < 8; k++)
+  {
+    range[0] = v[0][k] < range[0] ? v[0][k] : range[0];
+    range[1] = v[1][k] > range[1] ? v[1][k] : range[1];
+    range[2] = v[2][k] > range[2] ? v[2][k] : range[2];
+  }
+
+  if(i < count)
+  {
+    checkStepFloat(range, src[i - 1], src[i]);
+    checkFloatScalar(src + i, count - i, range);
+  }
+}
+
+// The int8 and int16 checks run on the widened int32 lanes:
+#define DEFINE_ADD_CHECK_AVX2(name, srcType, load, scalar, checkStep) \
+  __attribute__((target("avx2"))) \
+  static void name(int32_t* sum, double* squares, const srcType* src, uint64_t count, int32_t* range) \
+  { \
+    if(count == 0) \
+      return; \
+    scalar(sum, squares, src, 1, range); \
+    __m256i lo = _mm256_set1_epi32(src[0]); \
+    __m256i hi = lo; \
+    __m256i step = _mm256_setzero_si256(); \
+    uint64_t i = 1; \
+    for(; i + 8 <= count; i += 8) \
+    { \
+      __m256i x = load(src + i); \
+      lo = _mm256_min_epi32(lo, x); \
+      hi = _mm256_max_epi32(hi, x); \
+      step = _mm256_max_epi32(step, _mm256_abs_epi32(_mm256_sub_epi32(x, load(src + i - 1)))); \
+      __m256i* s = (__m256i*) (sum + i); \
+      _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), x)); \
+      if(squares) \
+        addSquaresEpi32Avx2(squares + i, x); \
+    } \
+    checkRangeEpi32Avx2(range, lo, hi, step); \
+    if(i < count) \
+    { \
+      checkStep(range, src[i - 1], src[i]); \
+      scalar(sum + i, squares ? squares + i : NULL, src + i, count - i, range); \
+    } \
+  }
+
+#define LOAD_INT8_AVX2(p) _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*) (p)))
+#define LOAD_INT16_AVX2(p) _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (p)))
+
+DEFINE_ADD_CHECK_AVX2(addCheckInt8To32Avx2, int8_t, LOAD_INT8_AVX2, addCheckInt8To32Scalar, checkStepInt8)
+DEFINE_ADD_CHECK_AVX2(addCheckInt16To32Avx2, int16_t, LOAD_INT16_AVX2, addCheckInt16To32Scalar, checkStepInt16)
+
+__attribute__((target("avx2")))
+static void normalizeInt32Avx2(float* mean, const int32_t* sum, uint64_t length, double count, double zero, double scale)
+{
+  __m256d c = _mm256_set1_pd(count);
+  __m256d z = _mm256_set1_pd(zero);
+  __m256d k = _mm256_set1_pd(scale);
+  uint64_t i = 0;
+  for(; i + 4 <= length; i += 4)
+  {
+    __m256d x = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (sum + i)));
+    _mm_storeu_ps(mean + i, _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_sub_pd(_mm256_div_pd(x, c), z), k)));
+  }
+  normalizeInt32Scalar(mean + i, sum + i, length - i, count, zero, scale);
+}
+
+__attribute__((target("avx2")))
+static void firFloatAvx2(float* dst, const float* src, const float* taps, unsigned tapCount, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256 sum = _mm256_setzero_ps();
+    for(unsigned k = 0; k < tapCount; k++)
+    {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(taps[k]), _mm256_loadu_ps(src + i + k)));
+    }
+    _mm256_storeu_ps(dst + i, sum);
+  }
+  firFloatScalar(dst + i, src + i, taps, tapCount, count - i);
+}
+
+__attribute__((target("avx2")))
+static double dotFloatAvx2(const float* x, const float* y, uint64_t count)
+{
+  __m256d lo = _mm256_setzero_pd();
+  __m256d hi = _mm256_setzero_pd();
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256 p = _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i));
+    lo = _mm256_add_pd(lo, _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+    hi = _mm256_add_pd(hi, _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(lo, hi));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dotFloatScalar(x + i, y + i, count - i);
+}
+
+static const Kernels_t KernelsAvx2 = {
+  "avx2",
+  addFloatAvx2,
+  addInt8To32Avx2,
+  addInt16To32Avx2,
+  addInt32To32Avx2,
+  addInt32To64Avx2,
+  addFloatToDoubleAvx2,
+  addSquaresFloatAvx2,
+  addSquaresInt8To32Avx2,
+  addSquaresInt16To32Avx2,
+  checkFloatAvx2,
+  addCheckInt8To32Avx2,
+  addCheckInt16To32Avx2,
+  normalizeInt32Avx2,
+  firFloatAvx2,
+  dotFloatAvx2
+};
+
+// AVX-512 foundation instructions only:
+
+__attribute__((target("avx512f")))
+static void addFloatAvx512(float* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    _mm512_storeu_ps(sum + i, _mm512_add_ps(_mm512_loadu_ps(sum + i), _mm512_loadu_ps(src + i)));
+  }
+  addFloatScalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addInt8To32Avx512(int32_t* sum, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512i x = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+    _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), x));
+  }
+  addInt8To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addInt16To32Avx512(int32_t* sum, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) (src + i)));
+    _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), x));
+  }
+  addInt16To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addInt32To32Avx512(int32_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), _mm512_loadu_si512(src + i)));
+  }
+  addInt32To32Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addInt32To64Avx512(int64_t* sum, const int32_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m512i x = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*) (src + i)));
+    _mm512_storeu_si512(sum + i, _mm512_add_epi64(_mm512_loadu_si512(sum + i), x));
+  }
+  addInt32To64Scalar(sum + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addFloatToDoubleAvx512(double* sum, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    _mm512_storeu_pd(sum + i, _mm512_add_pd(_mm512_loadu_pd(sum + i), _mm512_cvtps_pd(_mm256_loadu_ps(src + i))));
+    _mm512_storeu_pd(sum + i + 8, _mm512_add_pd(_mm512_loadu_pd(sum + i + 8), _mm512_cvtps_pd(_mm256_loadu_ps(src + i + 8))));
+  }
+  addFloatToDoubleScalar(sum + i, src + i, count - i);
+}
+
+// squares[0..15] += x^2 for 16 int32 x:
+__attribute__((target("avx512f")))
+static inline void addSquaresEpi32Avx512(double* squares, __m512i x)
+{
+  __m512d lo = _mm512_cvtepi32_pd(_mm512_castsi512_si256(x));
+  __m512d hi = _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(x, 1));
+  _mm512_storeu_pd(squares, _mm512_add_pd(_mm512_loadu_pd(squares), _mm512_mul_pd(lo, lo)));
+  _mm512_storeu_pd(squares + 8, _mm512_add_pd(_mm512_loadu_pd(squares + 8), _mm512_mul_pd(hi, hi)));
+}
+
+__attribute__((target("avx512f")))
+static void addSquaresFloatAvx512(float* sum, double* squares, const float* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512 x = _mm512_loadu_ps(src + i);
+    __m512d lo = _mm512_cvtps_pd(_mm256_loadu_ps(src + i));
+    __m512d hi = _mm512_cvtps_pd(_mm256_loadu_ps(src + i + 8));
+    _mm512_storeu_ps(sum + i, _mm512_add_ps(_mm512_loadu_ps(sum + i), x));
+    _mm512_storeu_pd(squares + i, _mm512_add_pd(_mm512_loadu_pd(squares + i), _mm512_mul_pd(lo, lo)));
+    _mm512_storeu_pd(squares + i + 8, _mm512_add_pd(_mm512_loadu_pd(squares + i + 8), _mm512_mul_pd(hi, hi)));
+  }
+  addSquaresFloatScalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addSquaresInt8To32Avx512(int32_t* sum, double* squares, const int8_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512i x = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+    _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), x));
+    addSquaresEpi32Avx512(squares + i, x);
+  }
+  addSquaresInt8To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void addSquaresInt16To32Avx512(int32_t* sum, double* squares, const int16_t* src, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) (src + i)));
+    _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), x));
+    addSquaresEpi32Avx512(squares + i, x);
+  }
+  addSquaresInt16To32Scalar(sum + i, squares + i, src + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void checkFloatAvx512(const float* src, uint64_t count, float* range)
+{
+  if(count == 0)
+    return;
+
+  checkFloatScalar(src, 1, range);
+  __m512 lo = _mm512_set1_ps(src[0]);
+  __m512 hi = lo;
+  __m512 step = _mm512_setzero_ps();
+  uint64_t i = 1;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512 x = _mm512_loadu_ps(src + i);
+    lo = _mm512_min_ps(lo, x);
+    hi = _mm512_max_ps(hi, x);
+    step = _mm512_max_ps(step, _mm512_abs_ps(_mm512_sub_ps(x, _mm512_loadu_ps(src + i - 1))));
+  }
+
+  float min = _mm512_reduce_min_ps(lo);
+  float max = _mm512_reduce_max_ps(hi);
+  float maxStep = _mm512_reduce_max_ps(step);
+  range[0] = min < range[0] ? min : range[0];
+  range[1] = max > range[1] ? max : range[1];
+  range[2] = maxStep > range[2] ? maxStep : range[2];
+
+  if(i < count)
+  {
+    checkStepFloat(range, src[i - 1], src[i]);
+    checkFloatScalar(src + i, count - i, range);
+  }
+}
+
+#define DEFINE_ADD_CHECK_AVX512(name, srcType, load, scalar, checkStep) \
+  __attribute__((target("avx512f"))) \
+  static void name(int32_t* sum, double* squares, const srcType* src, uint64_t count, int32_t* range) \
+  { \
+    if(count == 0) \
+      return; \
+    scalar(sum, squares, src, 1, range); \
+    __m512i lo = _mm512_set1_epi32(src[0]); \
+    __m512i hi = lo; \
+    __m512i step = _mm512_setzero_si512(); \
+    uint64_t i = 1; \
+    for(; i + 16 <= count; i += 16) \
+    { \
+      __m512i x = load(src + i); \
+      lo = _mm512_min_epi32(lo, x); \
+      hi = _mm512_max_epi32(hi, x); \
+      step = _mm512_max_epi32(step, _mm512_abs_epi32(_mm512_sub_epi32(x, load(src + i - 1)))); \
+      _mm512_storeu_si512(sum + i, _mm512_add_epi32(_mm512_loadu_si512(sum + i), x)); \
+      if(squares) \
+        addSquaresEpi32Avx512(squares + i, x); \
+    } \
+    int32_t min = _mm512_reduce_min_epi32(lo); \
+    int32_t max = _mm512_reduce_max_epi32(hi); \
+    int32_t maxStep = _mm512_reduce_max_epi32(step); \
+    range[0] = min < range[0] ? min : range[0]; \
+    range[1] = max > range[1] ? max : range[1]; \
+    range[2] = maxStep > range[2] ? maxStep : range[2]; \
+    if(i < count) \
+    { \
+      checkStep(range, src[i - 1], src[i]); \
+      scalar(sum + i, squares ? squares + i : NULL, src + i, count - i, range); \
+    } \
+  }
+
+#define LOAD_INT8_AVX512(p) _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*) (p)))
+#define LOAD_INT16_AVX512(p) _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*) (p)))
+
+DEFINE_ADD_CHECK_AVX512(addCheckInt8To32Avx512, int8_t, LOAD_INT8_AVX512, addCheckInt8To32Scalar, checkStepInt8)
+DEFINE_ADD_CHECK_AVX512(addCheckInt16To32Avx512, int16_t, LOAD_INT16_AVX512, addCheckInt16To32Scalar, checkStepInt16)
+
+__attribute__((target("avx512f")))
+static void normalizeInt32Avx512(float* mean, const int32_t* sum, uint64_t length, double count, double zero, double scale)
+{
+  __m512d c = _mm512_set1_pd(count);
+  __m512d z = _mm512_set1_pd(zero);
+  __m512d k = _mm512_set1_pd(scale);
+  uint64_t i = 0;
+  for(; i + 8 <= length; i += 8)
+  {
+    __m512d x = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*) (sum + i)));
+    _mm256_storeu_ps(mean + i, _mm512_cvtpd_ps(_mm512_mul_pd(_mm512_sub_pd(_mm512_div_pd(x, c), z), k)));
+  }
+  normalizeInt32Scalar(mean + i, sum + i, length - i, count, zero, scale);
+}
+
+__attribute__((target("avx512f")))
+static void firFloatAvx512(float* dst, const float* src, const float* taps, unsigned tapCount, uint64_t count)
+{
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512 sum = _mm512_setzero_ps();
+    for(unsigned k = 0; k < tapCount; k++)
+    {
+      sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(taps[k]), _mm512_loadu_ps(src + i + k)));
+    }
+    _mm512_storeu_ps(dst + i, sum);
+  }
+  firFloatScalar(dst + i, src + i, taps, tapCount, count - i);
+}
+
+__attribute__((target("avx512f")))
+static double dotFloatAvx512(const float* x, const float* y, uint64_t count)
+{
+  __m512d lo = _mm512_setzero_pd();
+  __m512d hi = _mm512_setzero_pd();
+  uint64_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m512 p = _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i));
+    lo = _mm512_add_pd(lo, _mm512_cvtps_pd(_mm512_castps512_ps256(p)));
+    hi = _mm512_add_pd(hi, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(p), 1))));
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(lo, hi)) + dotFloatScalar(x + i, y + i, count - i);
+}
+
+static const Kernels_t KernelsAvx512 = {
+  "avx512",
+  addFloatAvx512,
+  addInt8To32Avx512,
+  addInt16To32Avx512,
+  addInt32To32Avx512,
+  addInt32To64Avx512,
+  addFloatToDoubleAvx512,
+  addSquaresFloatAvx512,
+  addSquaresInt8To32Avx512,
+  addSquaresInt16To32Avx512,
+  checkFloatAvx512,
+  addCheckInt8To32Avx512,
+  addCheckInt16To32Avx512,
+  normalizeInt32Avx512,
+  firFloatAvx512,
+  dotFloatAvx512
+};
+
+#endif // KERNELS_X86
+
+const Kernels_t* kernelsAvailable(unsigned index)
+{
+  static const Kernels_t* available[4];
+  static unsigned count = 0;
+
+  if(count == 0)
+  {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+      available[count++] = &KernelsAvx512;
+    if(__builtin_cpu_supports("avx2"))
+      available[count++] = &KernelsAvx2;
+    if(__builtin_cpu_supports("sse2"))
+      available[count++] = &KernelsSse2;
+#endif
+    available[count++] = &KernelsScalar;
+  }
+
+  return index < count ? available[index] : NULL;
+}
+
+const Kernels_t* kernels()
+{
+  static const Kernels_t* selected = NULL;
+
+  if(!selected)
+    selected = kernelsAvailable(0);
+
+  return selected;
+}
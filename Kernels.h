@@ -0,0 +1,60 @@
+/**
+ * Kernels.h
+ * @author Simon Collignon
+ *
+ * Vectorized inner loops of the accumulator: SSE2, AVX2 and AVX-512 versions
+ * are compiled side by side and the widest one the CPU supports is picked at
+ * run time, so the binary still runs on machines without AVX.
+ */
+
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+  const char* name;
+
+  // sum[i] += src[i], widening the source type to the sum type:
+  void (*addFloat)(float* sum, const float* src, uint64_t count);
+  void (*addInt8To32)(int32_t* sum, const int8_t* src, uint64_t count);
+  void (*addInt16To32)(int32_t* sum, const int16_t* src, uint64_t count);
+  void (*addInt32To32)(int32_t* sum, const int32_t* src, uint64_t count);
+  void (*addInt32To64)(int64_t* sum, const int32_t* src, uint64_t count);
+  void (*addFloatToDouble)(double* sum, const float* src, uint64_t count);
+
+  // The same and squares[i] += (double) src[i] * src[i] in the same pass,
+  // products of floats and of integers are exact in double:
+  void (*addSquaresFloat)(float* sum, double* squares, const float* src, uint64_t count);
+  void (*addSquaresInt8To32)(int32_t* sum, double* squares, const int8_t* src, uint64_t count);
+  void (*addSquaresInt16To32)(int32_t* sum, double* squares, const int16_t* src, uint64_t count);
+
+  // The same, squares may be NULL, and range[0] and range[1] lowered and
+  // raised to the smallest and largest sample, range[2] raised to the largest
+  // step between neighbouring samples of the call. Floats are only checked,
+  // a float sum can't be taken back out exactly, so they are added after:
+  void (*checkFloat)(const float* src, uint64_t count, float* range);
+  void (*addCheckInt8To32)(int32_t* sum, double* squares, const int8_t* src, uint64_t count, int32_t* range);
+  void (*addCheckInt16To32)(int32_t* sum, double* squares, const int16_t* src, uint64_t count, int32_t* range);
+
+  // mean[i] = (float) (((double) sum[i] / count - zero) * scale), the same
+  // operations in the same order as the scalar code, so the result is identical:
+  void (*normalizeInt32)(float* mean, const int32_t* sum, uint64_t length, double count, double zero, double scale);
+
+  // dst[i] = sum of taps[k] * src[i + k] for k in [0, tapCount), the sets
+  // with FMA round the products differently:
+  void (*firFloat)(float* dst, const float* src, const float* taps, unsigned tapCount, uint64_t count);
+
+  // Sum of x[i] * y[i], accumulated in double:
+  double (*dotFloat)(const float* x, const float* y, uint64_t count);
+} Kernels_t;
+
+// Kernel set number index the CPU supports, widest first and the scalar one
+// last, NULL past the end:
+const Kernels_t* kernelsAvailable(unsigned index);
+
+// Widest kernel set the CPU supports:
+const Kernels_t* kernels();
+
+#endif
@@ -4,22 +4,53 @@
  *
  * This code performs the averaging of a set of block mode measurments.
  *
+ * The run is set up by config files and key=value arguments, see Config.h:
+ *   OscilloscopeAveraging [config file | key=value]...
+ * OscilloscopeAveragingHybrid.cfg and OscilloscopeAveragingBlock.cfg hold the
+ * settings of the former hybrid and block examples.
+ *
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <time.h>
+#include <string.h>
 #include <inttypes.h>
 #include <libtiepie.h>
+#include "Accumulator.h"
+#include "BinaryOutput.h"
 #include "CheckStatus.h"
+#include "Config.h"
+#include "CsvOutput.h"
+#include "OutputFile.h"
+#include "OutputWriter.h"
+#include "Parallel.h"
+#include "PhaseCorrection.h"
 #include "PrintInfo.h"
+#include "RawArchive.h"
+#include "ScopeEvents.h"
+#include "Snapshots.h"
+#include "SnrEstimator.h"
+#include "Stream.h"
+#include "Timing.h"
+#include "Transfer.h"
+#include "TriggerAlignment.h"
 #include "Utils.h"
 
 int main(int argc, char* argv[])
 {
   int status = EXIT_SUCCESS;
 
+  // Read the run parameters, later arguments override earlier ones:
+  Config_t config;
+  configDefaults(&config);
+
+  if(!configParseArgs(&config, argc, argv))
+  {
+    fprintf(stderr, "Usage: %s [config file | key=value]..." NEWLINE, argv[0]);
+    return EXIT_FAILURE;
+  }
+
   // Initialize library:
   LibInit();
 
@@ -64,46 +95,59 @@ int main(int argc, char* argv[])
     // Set measure mode:
     ScpSetMeasureMode(scp, MM_BLOCK);
 
-    // Enable channel 1 to measure it
-    ScpChSetEnabled(scp, 0, BOOL8_TRUE);
-    CHECK_LAST_STATUS();
+    // Enable channel 1 and the reference channels to measure them, disable
+    // the others to get the maximum sampling frequency
+    uint16_t averagedChannelCount = config.channelCount < channelCount ? (uint16_t) config.channelCount : channelCount;
 
-    // Disable channel 2 to get the maximum sampling frequency 
-    ScpChSetEnabled(scp, 1, BOOL8_FALSE);
-    CHECK_LAST_STATUS();
+    if(config.channelCount > channelCount)
+    {
+      printf("averaging the %" PRIu16 " channels of the oscilloscope \n", channelCount);
+    }
+
+    for(uint16_t ch = 0; ch < channelCount; ch++)
+    {
+      ScpChSetEnabled(scp, ch, ch < averagedChannelCount ? BOOL8_TRUE : BOOL8_FALSE);
+      CHECK_LAST_STATUS();
+    }
 
-    double fs = 500e6;
+    double fs = config.sampleFrequency;
     // Set sample frequency:
      ScpSetSampleFrequency(scp, fs); // Hz
 
     // Set record length:
-    uint64_t recLength = 50000000; // Sa
+    uint64_t recLength = config.recordLength; // Sa
     uint64_t recordLength = ScpSetRecordLength(scp, recLength); 
     CHECK_LAST_STATUS();
 
     // Set pre sample ratio:
 	// The trigger point is located at position pre sample ratio * recordLength
-	double sampleRatio = 400e-9 * fs / recordLength; // offset of 250ns
+	double sampleRatio = config.triggerDelay * fs / recordLength; // offset of 250ns
     ScpSetPreSampleRatio(scp, sampleRatio); 
 
     // Set range:
-    double range = 0.4;
+    double range = config.range;
     ScpChSetRange(scp, 0, range); // Volts
     CHECK_LAST_STATUS();
 
-    // ScpChSetRange(scp, 1, 4);
-    // CHECK_LAST_STATUS();
+    for(uint16_t ch = 1; ch < averagedChannelCount; ch++)
+    {
+      ScpChSetRange(scp, ch, config.referenceRange);
+      CHECK_LAST_STATUS();
+    }
 	
 	// Set resolution:
-	uint8_t bitRes = 12;
+	uint8_t bitRes = (uint8_t) config.resolution;
 	ScpSetResolution (scp, bitRes);
 
     // Set coupling:
     ScpChSetCoupling(scp, 0, CK_ACV); // Volts
     CHECK_LAST_STATUS();
 
-    // ScpChSetCoupling(scp, 1, CK_DCV)
-	// // CHECK_LAST_STATUS();
+    for(uint16_t ch = 1; ch < averagedChannelCount; ch++)
+    {
+      ScpChSetCoupling(scp, ch, CK_DCV);
+      CHECK_LAST_STATUS();
+    }
 
     // Set trigger timeout:
     ScpSetTriggerTimeOut(scp, 100e-3); // ms
@@ -145,168 +189,598 @@ int main(int argc, char* argv[])
     // Print oscilloscope info:
     printDeviceInfo(scp);
 
+    // Print run parameters:
+    configPrint(&config, stdout);
+
     // --- averaging modifications start here ---
 
-    clock_t start, end;
-    double cpu_time_used;
-    channelCount = 1; // we only want channel 1!
-    uint16_t blockCount = 20; // number of acquisition blocks that are averaged together
-    int cycleLength = 10000;
+    channelCount = averagedChannelCount; // channel 1 and the reference channels
+    uint64_t blockCount = config.blockCount; // number of acquisition blocks that are averaged together
+    uint64_t cycleLength = config.cycleLength ? config.cycleLength : recordLength; // the whole record is kept as one cycle when 0
     float cycleCount = recordLength / cycleLength; // WARNING recordLength HAS to be a multiple of cycleLength for the code to work.
     printf("number of cycle is %f \n", cycleCount);
 
-    start = clock();
+    // Capture one segment per FID trigger instead of one record holding all of
+    // them: the scope re-arms in hardware, FID period jitter doesn't matter and
+    // the dead time between FIDs isn't transferred:
+    bool8_t segmented = config.segmented;
+    uint64_t segmentLength = config.segmentLength ? config.segmentLength : cycleLength; // Sa per FID, may be shorter than the FID period
+    uint32_t segmentCount = 1;
 
-    // Create data buffers
-    float** averageData = malloc(sizeof(float*) * channelCount);
-    float** channelData = malloc(sizeof(float*) * channelCount);
-    float** finalData = malloc(sizeof(float*) * channelCount); // changing here to double?
+    if(segmented)
+    {
+      recordLength = ScpSetRecordLength(scp, segmentLength);
+      CHECK_LAST_STATUS();
+      segmentCount = ScpSetSegmentCount(scp, (uint32_t) cycleCount);
+      CHECK_LAST_STATUS();
+      sampleRatio = config.triggerDelay * fs / recordLength; // same offset as above
+      ScpSetPreSampleRatio(scp, sampleRatio);
+      CHECK_LAST_STATUS();
 
-    for(uint16_t ch = 0; ch < channelCount; ch++)
+      cycleLength = recordLength;
+      cycleCount = segmentCount;
+      printf("number of segments is %" PRIu32 " \n", segmentCount);
+    }
+
+    // Stream continuously instead of arming a block per acquisition, so no time
+    // is lost between blocks, at sample rates the link can sustain:
+    bool8_t streaming = config.streaming; // not combined with segmented, configCheck rejects it
+    uint64_t streamCycleCount = config.streamCycleCount; // FID cycles per stream record
+    uint64_t targetCycleCount = blockCount * (uint64_t) cycleCount; // as many averages as in block mode
+    StreamStats_t streamStats = {0};
+
+    if(streaming)
     {
-      averageData[ch] = malloc(sizeof(float) * recordLength);
-      channelData[ch] = malloc(sizeof(float) * recordLength);
-      finalData[ch] = malloc(sizeof(float) * cycleLength);
+      ScpSetMeasureMode(scp, MM_STREAM);
+      CHECK_LAST_STATUS();
+      recordLength = ScpSetRecordLength(scp, streamCycleCount * cycleLength);
+      CHECK_LAST_STATUS();
     }
 
-    // Initialize average buffers to 0
-    for(uint16_t ch = 0; ch < channelCount; ch++)
+    // Sum raw ADC codes instead of volts, scaled only once on output:
+    bool8_t rawData = config.rawData;
+    RawFormat_t rawFormat;
+
+    for(uint16_t ch = 0; rawData && ch < channelCount; ch++)
     {
-      for(uint64_t i = 0; i < recordLength; i++)
-      {
-        averageData[ch][i] = (float)  0;
-      }
-      for(uint64_t i = 0; i < cycleLength; i++)
+      if(!rawFormatGet(scp, ch, &rawFormat))
       {
-        finalData[ch][i] = (float) 0;
+        fprintf(stderr, "Falling back to averaging volts" NEWLINE);
+        rawData = BOOL8_FALSE;
       }
     }
 
-    // Averaging the acquisition blocks
-    for(uint16_t i = 0; i < blockCount; i++)
+    // Align every FID on the phase of the reference tone before it is summed,
+    // the samples are delayed by fractions of a sample so this sums volts:
+    bool8_t phaseCorrection = config.phaseCorrection;
+    uint16_t referenceChannel = (uint16_t) config.referenceChannel;
+    PhaseCorrection_t phaseCorrector = {0};
+
+    if(phaseCorrection && config.referenceChannel >= channelCount)
     {
-      // Start measurement
-      ScpStart(scp);
-      CHECK_LAST_STATUS();
+      fprintf(stderr, "Reference channel Ch%" PRIu64 " isn't measured, no phase correction" NEWLINE, config.referenceChannel + 1);
+      phaseCorrection = BOOL8_FALSE;
+    }
+
+    // Align every FID on the leading edges of the previous ones, against
+    // the jitter of the external trigger:
+    bool8_t triggerAlignment = config.triggerAlignment;
+    TriggerAlignment_t aligner = {0};
+
+    if(triggerAlignment && config.alignmentChannel >= channelCount)
+    {
+      fprintf(stderr, "Alignment channel Ch%" PRIu64 " isn't measured, no trigger alignment" NEWLINE, config.alignmentChannel + 1);
+      triggerAlignment = BOOL8_FALSE;
+    }
+
+    if((phaseCorrection || triggerAlignment) && rawData)
+    {
+      printf("averaging volts for the alignment \n");
+      rawData = BOOL8_FALSE;
+    }
+
+    // Only transfer and average the regions of interest of every cycle, packed
+    // into the bins one after the other:
+    Roi_t roi = config.roi;
+
+    if(roi.count && (segmented || phaseCorrection || triggerAlignment))
+    {
+      printf("averaging whole cycles, regions of interest need unsegmented cycles without alignment \n");
+      roi.count = 0;
+    }
+
+    uint64_t binCount = roiLength(&roi, cycleLength); // Sa per channel of the averaged cycle
+    uint64_t binRecordLength = recordLength / cycleLength * binCount; // Sa per channel of a record, packed
+
+    // Fold each block into the FID cycle bins as it arrives, instead of summing
+    // whole records and folding them after the last block:
+    bool8_t foldEachBlock = config.foldEachBlock;
+
+    // Threads folding the record sums after the last block and aligning the
+    // cycles, one per core by default:
+    unsigned threadCount = config.threadCount ? (unsigned) config.threadCount : parallelCoreCount();
+
+    // Leave out the cycles with a saturated sample or a glitch, checked while
+    // they are accumulated:
+    bool8_t rejection = config.rejection;
+
+    if(rejection && !foldEachBlock)
+    {
+      printf("no rejection without foldEachBlock \n");
+      rejection = BOOL8_FALSE;
+    }
+
+    // Samples per channel and ScpGetData call, 0 transfers the whole record at once:
+    uint64_t chunkLength = config.chunkLength;
+    if((phaseCorrection || triggerAlignment || rejection) && chunkLength)
+      chunkLength = (chunkLength + cycleLength - 1) / cycleLength * cycleLength; // cycles are aligned and checked whole
+    if(roi.count && chunkLength)
+      chunkLength = chunkLength < binCount ? binCount : chunkLength / binCount * binCount; // windows are read for whole cycles
+    bool8_t overlapTransfer = config.overlapTransfer && !roi.count; // fold a chunk while the next one is transferred
+
+    // Keep the raw codes of every block in <stem>_raw.bin, to average them
+    // again offline. The codes are transferred straight into the file:
+    bool8_t rawArchive = config.rawArchive;
+
+    if(rawArchive && (!rawData || roi.count))
+    {
+      printf("no raw archive without raw data of whole cycles \n");
+      rawArchive = BOOL8_FALSE;
+    }
+
+    // Repeat the run, each result to its own files, written in the
+    // background while the next run acquires:
+    OutputWriter_t writer;
+
+    if(!outputWriterInit(&writer, (unsigned) config.writerQueueLength))
+    {
+      fprintf(stderr, "Couldn't allocate the output queue!" NEWLINE);
+      status = EXIT_FAILURE;
+    }
+
+    for(uint64_t run = 0; run < config.runCount && status == EXIT_SUCCESS; run++)
+    {
+      if(config.runCount > 1)
+        printf("run %" PRIu64 " of %" PRIu64 " \n", run + 1, config.runCount);
 
-      // Wait for measurement to complete
-      while(!ScpIsDataReady(scp) && !ObjIsRemoved(scp))
+      // Reserve the output number before the run, the snapshots are named after it:
+      FILE *csv;
+      char stem[OUTPUT_STEM_LENGTH];
+
+      if(!outputFileReserve(config.outputDirectory, stem))
       {
-        sleepMiliSeconds(10); // 10 ms delay, to save CPU time.
+        status = EXIT_FAILURE;
+        break;
       }
 
-      if(ObjIsRemoved(scp))
+      char filename[OUTPUT_PATH_LENGTH];
+      char binaryFilename[OUTPUT_PATH_LENGTH];
+      snprintf(filename, sizeof(filename), "%s.csv", stem);
+      snprintf(binaryFilename, sizeof(binaryFilename), "%s.bin", stem);
+
+      // Wall clock time of each acquisition phase, per block, started once the
+      // buffers, the archive and the events are set up:
+      Timing_t timing;
+      timingInit(&timing);
+      uint64_t acquiredBlockCount = 0;
+
+      // Create data buffers
+      Accumulator_t averageData = {0};
+      Accumulator_t finalData = {0};
+      Transfer_t transfer = {0};
+
+      // Initialize average buffers to 0, every segment of a block is a record of averageData:
+      if((!foldEachBlock && !accumulatorInit(&averageData, scp, channelCount, binRecordLength, rawData, blockCount * segmentCount, config.floatFlushInterval)) ||
+         !accumulatorInit(&finalData, scp, channelCount, binCount, rawData, blockCount * (uint64_t) cycleCount, config.floatFlushInterval) ||
+         !transferInit(&transfer, foldEachBlock ? &finalData : &averageData, binRecordLength, segmented ? 0 : chunkLength, overlapTransfer))
       {
-        fprintf(stderr, "Device gone!");
+        fprintf(stderr, "Couldn't allocate the average buffers!" NEWLINE);
         status = EXIT_FAILURE;
       }
-      else if(ScpIsDataReady(scp))
+
+      if(status == EXIT_SUCCESS && roi.count && !transferSetRoi(&transfer, &roi, cycleLength))
       {
-        // Get the data from the scope:
-        recordLength = ScpGetData(scp, channelData, channelCount, 0, recordLength);
-        CHECK_LAST_STATUS();
+        fprintf(stderr, "Couldn't set up the regions of interest, they must lie inside the cycle!" NEWLINE);
+        status = EXIT_FAILURE;
+      }
+
+      transfer.timing = &timing;
+      transfer.timeout = config.dataReadyTimeout; // per chunk of an async transfer
+
+      // Sum the squares of the samples as well, for error bars on every sample,
+      // and the per block means in block mode when a block has several cycles,
+      // with one they only repeat the variance across cycles:
+      bool8_t variance = config.variance;
+
+      if(status == EXIT_SUCCESS && variance &&
+         !(foldEachBlock ? accumulatorEnableVariance(&finalData, !streaming && cycleCount > 1) :
+           accumulatorEnableVariance(&averageData, BOOL8_FALSE) && accumulatorEnableVariance(&finalData, BOOL8_FALSE)))
+      {
+        fprintf(stderr, "Couldn't allocate the variance buffers!" NEWLINE);
+        status = EXIT_FAILURE;
+      }
+
+      // The steps between the packed windows aren't steps of the signal:
+      double glitchStep = roi.count ? 0 : config.glitchStep;
 
-        for(uint16_t ch = 0; ch < channelCount; ch++)
+      if(status == EXIT_SUCCESS && rejection && !accumulatorEnableRejection(&finalData, scp, config.glitchLevel, glitchStep))
+      {
+        fprintf(stderr, "Couldn't set up the rejection of saturated cycles and glitches!" NEWLINE);
+        status = EXIT_FAILURE;
+      }
+
+      if(status == EXIT_SUCCESS && phaseCorrection)
+      {
+        if(phaseCorrectionInit(&phaseCorrector, channelCount, cycleLength, transfer.chunkLength, referenceChannel, config.referenceFrequency / fs, config.referenceWindow, threadCount))
         {
-          for(uint64_t i = 0; i < recordLength; i++)
-          {
-            averageData[ch][i] += channelData[ch][i]; // we accumulate in averageData buffer
-          }
+          transfer.phaseCorrection = &phaseCorrector;
         }
-      } 
-    }
+        else
+        {
+          fprintf(stderr, "Couldn't set up the phase correction!" NEWLINE);
+          status = EXIT_FAILURE;
+        }
+      }
 
-    // Averaging the FID cycles
-    for(uint16_t ch = 0; ch < channelCount; ch++)
-    {
-      for(uint64_t i = 0; i * cycleLength < recordLength; i++)
+      if(status == EXIT_SUCCESS && triggerAlignment)
       {
-        for(uint64_t j = 0; j < cycleLength; j++)
+        if(triggerAlignmentInit(&aligner, channelCount, cycleLength, transfer.chunkLength, (uint16_t) config.alignmentChannel, config.alignmentEdge, config.alignmentMaxDelay, threadCount))
         {
-          finalData[ch][j] += (float) averageData[ch][i * cycleLength + j]; // we populate finaData buffer
+          transfer.triggerAlignment = &aligner;
+        }
+        else
+        {
+          fprintf(stderr, "Couldn't set up the trigger alignment, alignmentEdge must be at least 4 alignmentMaxDelay!" NEWLINE);
+          status = EXIT_FAILURE;
         }
       }
-    }
 
-    // timing stop
-    end = clock();
-    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
-    printf("Elapsed time is %f seconds \n", (float) cpu_time_used);
+      // Snapshots of the running average at growing cycle counts, written in
+      // the background, for the noise versus the number of averages:
+      Snapshots_t snapshots = {0};
 
-    FILE *csv;
-    char filename[80];
-    int fileNumber = 0; 
-    sprintf(filename, "C:\\Users\\labo-admin\\Documents\\spectrometer-controller\\tiepie\\data\\record_%d.csv", fileNumber);
+      if(status == EXIT_SUCCESS && config.snapshotFirst && !foldEachBlock)
+      {
+        printf("no snapshots without foldEachBlock \n");
+      }
+      else if(status == EXIT_SUCCESS && config.snapshotFirst)
+      {
+        if(snapshotsInit(&snapshots, &finalData, config.snapshotFirst, config.snapshotRatio, filename, &roi, cycleLength, fs, config.timeColumn))
+        {
+          transfer.snapshots = &snapshots;
+        }
+        else
+        {
+          fprintf(stderr, "Couldn't set up the snapshots, snapshotRatio must be above 1!" NEWLINE);
+          status = EXIT_FAILURE;
+        }
+      }
 
-	// Check if the file already exist and iterate on the suffix number
-    while((csv = fopen(filename, "r"))) 
-    {
-      fclose(csv);
-      fileNumber++; 
-      sprintf(filename, "C:\\Users\\labo-admin\\Documents\\spectrometer-controller\\tiepie\\data\\record_%d.csv", fileNumber);
-    }
+      // Estimate the SNR of the average after every block or stream record and
+      // stop once a target is reached. Without variance only the squares of the
+      // noise window are summed:
+      SnrEstimator_t snr = {0};
+      SnrEstimator_t* snrEstimator = NULL;
+      uint64_t noiseBin, signalBin; // windows in the bins of the regions of interest
+
+      if(status == EXIT_SUCCESS && config.noiseLength && !foldEachBlock)
+      {
+        printf("no SNR estimate without foldEachBlock \n");
+      }
+      else if(status == EXIT_SUCCESS && config.noiseLength)
+      {
+        if(roiFind(&roi, config.noiseStart, config.noiseLength, &noiseBin) && roiFind(&roi, config.signalStart, config.signalLength, &signalBin) &&
+           accumulatorEnableWindowSquares(&finalData, noiseBin, config.noiseLength) &&
+           snrEstimatorInit(&snr, &finalData, (uint16_t) config.snrChannel, noiseBin, config.noiseLength,
+                            signalBin, config.signalLength, config.targetSnr, config.targetStdError))
+        {
+          snrEstimator = &snr;
+        }
+        else
+        {
+          fprintf(stderr, "Couldn't set up the SNR estimate, snrChannel must be measured and the windows inside the cycle or a region of interest!" NEWLINE);
+          status = EXIT_FAILURE;
+        }
+      }
 
-    // Open file with write/update permissions    
-    csv = fopen(filename, "w");
+      // Preallocated for every block of the run, or every record of the stream:
+      RawArchive_t archive = {0};
+      uint64_t archivedBlockCount = 0;
+      char archiveFilename[OUTPUT_PATH_LENGTH];
+      snprintf(archiveFilename, sizeof(archiveFilename), "%s_raw.bin", stem);
 
-    if(csv)
-    {
-      // Write csv header
-      fprintf(csv, "sampling rate [Sa/s]: %d \n", (int) fs);
-      fprintf(csv, "record length [Sa]: %d \n", (int) recLength);
-      fprintf(csv, "record duration [s]: %.8e \n", (float) recLength / fs);
-      fprintf(csv, "range [V]: %f \n", (float) range);
-	    fprintf(csv, "resolution [b]: %d \n", (int) bitRes);
-	    fprintf(csv, "amplitude resolution [V]:%.8e \n", (float) range / pow(2, bitRes - 1));
-      fprintf(csv, "block acquisition count: %f \n", (float) blockCount);
-      fprintf(csv, "FID per block count: %d \n", (int) cycleCount);
-      fprintf(csv, "number of averages: %d \n", (int) (blockCount * cycleCount));
-      fprintf(csv, "DAQ elapsed time [s]: %f \n", (float) cpu_time_used);
-      fprintf(csv, "Time");
-
-      for(uint16_t ch = 0; ch < channelCount; ch++)
+      if(status == EXIT_SUCCESS && rawArchive)
+      {
+        uint64_t archiveCapacity = streaming ? (targetCycleCount + streamCycleCount - 1) / streamCycleCount : blockCount;
+
+        if(rawArchiveOpen(&archive, archiveFilename, foldEachBlock ? &finalData : &averageData, recordLength, segmentCount, cycleLength, fs, archiveCapacity))
+        {
+          transfer.archive = &archive;
+        }
+        else
+        {
+          status = EXIT_FAILURE;
+        }
+      }
+
+      // Get notified when the data is ready instead of polling for it:
+      double dataReadyTimeout = config.dataReadyTimeout; // s, give up when a block takes longer than this
+      ScopeEvents_t events;
+      bool8_t eventsOpen = status == EXIT_SUCCESS && scopeEventsOpen(&events, scp);
+
+      if(status == EXIT_SUCCESS && !eventsOpen)
       {
-        fprintf(csv, ",Ch%" PRIu16, ch + 1);
+        fprintf(stderr, "Couldn't register oscilloscope events!" NEWLINE);
+        status = EXIT_FAILURE;
       }
-      fprintf(csv, "\n");
 
-      // Write the data to csv
-      for(uint64_t i = 0; i < cycleLength; i++)
+      timingStart(&timing);
+
+      // Streaming the acquisition
+      if(streaming && eventsOpen)
       {
-        fprintf(csv, "%e", (float) i / fs);
-        for(uint16_t ch = 0; ch < channelCount; ch++)
+        ScopeEvent_t event = streamAverage(scp, &events, &transfer, foldEachBlock ? &finalData : &averageData, recordLength, targetCycleCount, snrEstimator, dataReadyTimeout, &streamStats);
+
+        if(event == SCOPE_EVENT_DATA_OVERFLOW)
         {
-          fprintf(csv, ",%.8e", (float) finalData[ch][i] / (blockCount * cycleCount)); // 8 for float, 16 for double
+          fprintf(stderr, "Stream overflow, stopped after %" PRIu64 " records!" NEWLINE, streamStats.recordCount);
         }
-        fprintf(csv, " \n");
+        else if(event != SCOPE_EVENT_DATA_READY)
+        {
+          fprintf(stderr, "Stream stopped after %" PRIu64 " records!" NEWLINE, streamStats.recordCount);
+          status = EXIT_FAILURE;
+        }
+
+        printf("stream duty cycle is %f %% \n", (float) (100 * streamStats.dutyCycle));
       }
 
-      printf("Data written to: %s \n", filename);
+      // Averaging the acquisition blocks
+      for(uint64_t i = 0; i < blockCount && eventsOpen && !streaming; i++)
+      {
+        // Start measurement
+        timingBeginBlock(&timing);
+        ScpStart(scp);
+        CHECK_LAST_STATUS();
+        timingMark(&timing, TIMING_ARM);
 
-      // Close file
-      fclose(csv);
-    }
-    else
-    {
-      fprintf(stderr, "Couldn't open file: %s" NEWLINE, filename);
-      status = EXIT_FAILURE;
-    }
+        // Wait for measurement to complete
+        ScopeEvent_t event = scopeEventsWait(&events, dataReadyTimeout);
+        timingMark(&timing, TIMING_WAIT);
 
-    // Free data buffers
-    for(uint16_t ch = 0; ch < channelCount; ch++)
-    {
-      free(averageData[ch]);
-      free(channelData[ch]);
-      free(finalData[ch]);
-    }
+        if(event == SCOPE_EVENT_REMOVED)
+        {
+          fprintf(stderr, "Device gone!" NEWLINE);
+          status = EXIT_FAILURE;
+          break;
+        }
+        else if(event != SCOPE_EVENT_DATA_READY)
+        {
+          fprintf(stderr, "No data ready within %f seconds!" NEWLINE, dataReadyTimeout);
+          status = EXIT_FAILURE;
+          break;
+        }
+        else
+        {
+          // Get the data from the scope, folding it chunk by chunk:
+          transferBlock(&transfer, scp, foldEachBlock ? &finalData : &averageData, recordLength, segmentCount); // we accumulate in averageData or straight in finalData
+          CHECK_LAST_STATUS();
+
+          if(transfer.shortfall)
+          {
+            fprintf(stderr, "Block %" PRIu64 " transferred %" PRIu64 " Sa short!" NEWLINE, i, transfer.shortfall);
+          }
+
+          if(transfer.stalled)
+          {
+            status = EXIT_FAILURE;
+            break;
+          }
+
+          accumulatorEndBlock(&finalData); // nothing to do without variance across blocks
+          bool8_t reached = snrEstimator && snrEstimatorUpdate(snrEstimator, &finalData);
+          timingMark(&timing, TIMING_ACCUMULATE);
+          acquiredBlockCount++;
+
+          if(reached)
+          {
+            break;
+          }
+        } 
+      }
+
+      timingEndBlock(&timing);
+
+      if(eventsOpen)
+      {
+        scopeEventsClose(&events);
+      }
+
+      // Averaging the FID cycles
+      if(status == EXIT_SUCCESS && !foldEachBlock)
+      {
+        accumulatorFold(&finalData, &averageData, threadCount); // we populate finalData buffer
+        timingMark(&timing, TIMING_FOLD);
+      }
+
+      // timing stop
+      timingStop(&timing);
+      printf("Elapsed time is %f seconds \n", (float) timing.elapsed);
+
+      if(snrEstimator && snr.reached)
+      {
+        printf("SNR target reached after %" PRIu64 " averages \n", snr.count);
+      }
+
+      // The last snapshot may still be written:
+      snapshotsFinish(&snapshots);
+
+      if(snapshots.failedCount)
+      {
+        fprintf(stderr, "Couldn't write %" PRIu64 " snapshots!" NEWLINE, snapshots.failedCount);
+      }
+
+      // The kernel writes the rest of the archive back in the background. It
+      // stays mapped while the driver may still write into it:
+      if(transfer.archive && transfer.stalled)
+      {
+        fprintf(stderr, "Raw archive left open: %s" NEWLINE, archiveFilename);
+      }
+      else if(transfer.archive)
+      {
+        archivedBlockCount = archive.header->blockCount;
+        transfer.archive = NULL;
+
+        if(rawArchiveClose(&archive))
+        {
+          printf("%" PRIu64 " raw blocks archived to: %s \n", archivedBlockCount, archiveFilename);
+        }
+        else
+        {
+          fprintf(stderr, "Couldn't write the raw archive: %s" NEWLINE, archiveFilename);
+          status = EXIT_FAILURE;
+        }
+      }
+
+      const char* outputFilename = config.binaryOutput ? binaryFilename : filename;
+      BinaryHeader_t binaryHeader;
+
+      // Open file with write/update permissions, the binary one starts with
+      // its header and the csv header follows as text:
+      csv = fopen(outputFilename, config.binaryOutput ? "wb" : "w");
 
-    free(averageData);
-    free(channelData);
-    free(finalData);
+      if(csv && config.binaryOutput)
+      {
+        binaryHeaderInit(&binaryHeader, channelCount, 0, binCount, &roi, cycleLength, finalData.count, fs);
+        if(!binaryWriteHeader(csv, &binaryHeader))
+        {
+          fclose(csv);
+          csv = NULL;
+        }
+      }
 
-    // Close oscilloscope:
+      if(csv)
+      {
+        // Write csv header
+        fprintf(csv, "sampling rate [Sa/s]: %d \n", (int) fs);
+        fprintf(csv, "record length [Sa]: %d \n", (int) recLength);
+        fprintf(csv, "record duration [s]: %.8e \n", (float) recLength / fs);
+        fprintf(csv, "range [V]: %f \n", (float) range);
+        if(channelCount > 1)
+          fprintf(csv, "reference range [V]: %f \n", (float) config.referenceRange);
+  	    fprintf(csv, "resolution [b]: %d \n", (int) bitRes);
+  	    fprintf(csv, "amplitude resolution [V]:%.8e \n", (float) range / pow(2, bitRes - 1));
+        fprintf(csv, "block acquisition count: %f \n", (float) (streaming ? streamStats.recordCount : acquiredBlockCount));
+        fprintf(csv, "FID per block count: %d \n", (int) cycleCount);
+        fprintf(csv, "number of averages: %d \n", (int) finalData.count);
+        fprintf(csv, "DAQ elapsed time [s]: %f \n", (float) timing.elapsed);
+        if(streaming)
+        {
+          fprintf(csv, "stream record count: %" PRIu64 " \n", streamStats.recordCount);
+          fprintf(csv, "stream overflow count: %" PRIu64 " \n", streamStats.overflowCount);
+        }
+        if(roi.count)
+        {
+          fprintf(csv, "regions of interest [Sa]: ");
+          roiPrint(&roi, csv);
+          fprintf(csv, " \n");
+        }
+        if(transfer.phaseCorrection)
+        {
+          fprintf(csv, "phase corrected FID count: %" PRIu64 " \n", phaseCorrector.cycleCount);
+          fprintf(csv, "phase correction delay rms/max [Sa]: %.3e %.3e \n",
+            phaseCorrector.cycleCount ? sqrt(phaseCorrector.sumDelay2 / phaseCorrector.cycleCount) : 0, phaseCorrector.maxDelay);
+        }
+        if(transfer.triggerAlignment)
+        {
+          fprintf(csv, "trigger aligned FID count: %" PRIu64 " \n", aligner.cycleCount);
+          fprintf(csv, "trigger alignment delay rms/max [Sa]: %.3e %.3e \n",
+            aligner.cycleCount ? sqrt(aligner.sumDelay2 / aligner.cycleCount) : 0, aligner.maxDelay);
+        }
+        if(finalData.limits)
+          fprintf(csv, "rejected FIDs saturated/glitch: %" PRIu64 " %" PRIu64 " \n", finalData.saturatedCount, finalData.glitchCount);
+        if(rawArchive)
+          fprintf(csv, "raw archived block count: %" PRIu64 " \n", archivedBlockCount);
+        if(transfer.shortBlockCount)
+          fprintf(csv, "blocks transferred short: %" PRIu64 " \n", transfer.shortBlockCount);
+        if(transfer.snapshots)
+          fprintf(csv, "snapshot count: %" PRIu64 " \n", snapshots.writtenCount);
+        if(snrEstimator)
+        {
+          snrEstimatorUpdate(snrEstimator, &finalData);
+          fprintf(csv, "Ch%" PRIu16 " SNR estimate: %.3e \n", snr.channel + 1, snr.snr);
+          fprintf(csv, "Ch%" PRIu16 " signal rms / average noise rms [V]: %.8e %.8e \n", snr.channel + 1, snr.amplitude, snr.stdError);
+          fprintf(csv, "SNR target reached: %d \n", (int) snr.reached);
+        }
+        for(uint16_t ch = 0; finalData.sumSquares && ch < channelCount; ch++)
+        {
+          double noise = accumulatorNoiseRms(&finalData, ch, 0, binCount);
+          fprintf(csv, "Ch%" PRIu16 " FID noise rms [V]: %.8e \n", ch + 1, noise);
+          fprintf(csv, "Ch%" PRIu16 " average noise rms [V]: %.8e \n", ch + 1, finalData.count ? noise / sqrt((double) finalData.count) : 0);
+        }
+        timingWriteHeader(&timing, csv, streaming ? streamStats.sampleCount / fs : (double) acquiredBlockCount * recordLength * segmentCount / fs);
+        // The standard errors of the means follow the means, from the variance
+        // across cycles and, with at least 2 blocks, across blocks:
+        bool8_t cycleErrors = finalData.sumSquares != NULL;
+        bool8_t blockErrors = finalData.blockMeans != NULL && finalData.blockCount >= 2;
+        csvWriteColumnNames(csv, channelCount, cycleErrors, blockErrors);
+
+        // The data is scaled and written in the background, the next run
+        // starts right away. The writer owns the result and the timing now:
+        OutputJob_t* job = malloc(sizeof(OutputJob_t));
+
+        if(job)
+        {
+          job->file = csv;
+          snprintf(job->filename, sizeof(job->filename), "%s", outputFilename);
+          snprintf(job->timingFilename, sizeof(job->timingFilename), "%s_timing.csv", stem);
+          job->binary = config.binaryOutput;
+          job->binaryHeader = binaryHeader;
+          job->data = finalData;
+          job->cycleErrors = cycleErrors;
+          job->blockErrors = blockErrors;
+          job->roi = roi;
+          job->cycleLength = cycleLength;
+          job->fs = fs;
+          job->timeColumn = config.timeColumn;
+          job->timing = timing;
+          finalData = (Accumulator_t) {0};
+          timing = (Timing_t) {0};
+          outputWriterSubmit(&writer, job);
+        }
+        else
+        {
+          fprintf(stderr, "Couldn't allocate the output buffer!" NEWLINE);
+          fclose(csv);
+          status = EXIT_FAILURE;
+        }
+      }
+      else
+      {
+        fprintf(stderr, "Couldn't open file: %s" NEWLINE, outputFilename);
+        status = EXIT_FAILURE;
+      }
+
+      // Free data buffers
+      timingFree(&timing);
+      transferFree(&transfer);
+      phaseCorrectionFree(&phaseCorrector);
+      triggerAlignmentFree(&aligner);
+      snapshotsFree(&snapshots);
+      accumulatorFree(&averageData);
+      accumulatorFree(&finalData);
+    }
+
+    // Close oscilloscope, the last results may still be written after that:
     ObjClose(scp);
     CHECK_LAST_STATUS();
+
+    outputWriterFree(&writer);
+
+    if(writer.failedCount)
+    {
+      fprintf(stderr, "Couldn't write %" PRIu64 " results!" NEWLINE, writer.failedCount);
+      status = EXIT_FAILURE;
+    }
   }
   else
   {
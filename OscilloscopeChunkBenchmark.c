@@ -0,0 +1,169 @@
+/**
+ * OscilloscopeChunkBenchmark.c based on OscilloscopeAveraging.c
+ * @author Simon Collignon
+ *
+ * This code measures the throughput of the chunked transfer and fold of one
+ * block for a range of chunk lengths, with and without overlapping transfer
+ * and fold, to pick TRANSFER_DEFAULT_CHUNK_LENGTH.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "CheckStatus.h"
+#include "PrintInfo.h"
+#include "ScopeEvents.h"
+#include "Transfer.h"
+#include "Utils.h"
+
+int main(int argc, char* argv[])
+{
+  int status = EXIT_SUCCESS;
+
+  // Initialize library:
+  LibInit();
+
+  // Print library information:
+  printLibraryInfo();
+
+  // Enable network search:
+  NetSetAutoDetectEnabled(BOOL8_TRUE);
+  CHECK_LAST_STATUS();
+
+  // Update device list:
+  LstUpdate();
+  CHECK_LAST_STATUS();
+
+  // Try to open an oscilloscope with block measurement support:
+  LibTiePieHandle_t scp = LIBTIEPIE_HANDLE_INVALID;
+
+  for(uint32_t index = 0; index < LstGetCount(); index++)
+  {
+    if(LstDevCanOpen(IDKIND_INDEX, index, DEVICETYPE_OSCILLOSCOPE))
+    {
+      scp = LstOpenOscilloscope(IDKIND_INDEX, index);
+      CHECK_LAST_STATUS();
+
+      // Check for valid handle and block measurement support:
+      if(scp != LIBTIEPIE_HANDLE_INVALID && (ScpGetMeasureModes(scp) & MM_BLOCK))
+      {
+        break;
+      }
+      else
+      {
+        scp = LIBTIEPIE_HANDLE_INVALID;
+      }
+    }
+  }
+
+  if(scp != LIBTIEPIE_HANDLE_INVALID)
+  {
+    uint16_t channelCount = ScpGetChannelCount(scp);
+    CHECK_LAST_STATUS();
+
+    // Same acquisition settings as OscilloscopeAveraging.c, but free running:
+    ScpSetMeasureMode(scp, MM_BLOCK);
+    ScpChSetEnabled(scp, 0, BOOL8_TRUE);
+    CHECK_LAST_STATUS();
+    ScpChSetEnabled(scp, 1, BOOL8_FALSE);
+    CHECK_LAST_STATUS();
+    ScpSetSampleFrequency(scp, 500e6);
+    uint64_t recordLength = ScpSetRecordLength(scp, 50000000);
+    CHECK_LAST_STATUS();
+    ScpChSetRange(scp, 0, 0.4);
+    CHECK_LAST_STATUS();
+    ScpSetResolution(scp, 12);
+    ScpSetTriggerTimeOut(scp, 1e-3);
+    CHECK_LAST_STATUS();
+
+    for(uint16_t ch = 0; ch < channelCount; ch++)
+    {
+      ScpChTrSetEnabled(scp, ch, BOOL8_FALSE);
+      CHECK_LAST_STATUS();
+    }
+
+    channelCount = 1; // we only want channel 1!
+    int cycleLength = 10000;
+    int repeatCount = 3; // best of
+
+    // Measure one block, it is transferred again for every chunk length:
+    ScopeEvents_t events;
+
+    if(!scopeEventsOpen(&events, scp))
+    {
+      fprintf(stderr, "Couldn't register oscilloscope events!" NEWLINE);
+      status = EXIT_FAILURE;
+    }
+    else
+    {
+      ScpStart(scp);
+      CHECK_LAST_STATUS();
+
+      if(scopeEventsWait(&events, 10) != SCOPE_EVENT_DATA_READY)
+      {
+        fprintf(stderr, "No data ready!" NEWLINE);
+        status = EXIT_FAILURE;
+      }
+
+      scopeEventsClose(&events);
+    }
+
+    for(int mode = 0; mode < 4 && status == EXIT_SUCCESS; mode++)
+    {
+      bool8_t raw = mode < 2;
+      bool8_t async = mode % 2;
+      printf("%s data, %s transfer:" NEWLINE, raw ? "Raw" : "Float", async ? "overlapped" : "sequential");
+      printf("  chunk length [Sa]   throughput [MSa/s]" NEWLINE);
+
+      for(uint64_t chunkLength = 4096; chunkLength <= recordLength * 2; chunkLength *= 2)
+      {
+        Accumulator_t acc = {0};
+        Transfer_t transfer = {0};
+
+        if(!accumulatorInit(&acc, scp, channelCount, cycleLength, raw, repeatCount * (recordLength / cycleLength), ACCUMULATOR_DEFAULT_FLOAT_FLUSH_INTERVAL) ||
+           !transferInit(&transfer, &acc, recordLength, chunkLength, async))
+        {
+          fprintf(stderr, "Couldn't allocate the buffers!" NEWLINE);
+          status = EXIT_FAILURE;
+        }
+
+        double best = 0;
+        for(int i = 0; i < repeatCount && status == EXIT_SUCCESS; i++)
+        {
+          double start = monotonicSeconds();
+          uint64_t count = transferBlock(&transfer, scp, &acc, recordLength, 1);
+          double elapsed = monotonicSeconds() - start;
+
+          if(elapsed > 0 && count / elapsed > best)
+            best = count / elapsed;
+        }
+
+        if(status == EXIT_SUCCESS)
+          printf("  %17" PRIu64 "   %18.1f" NEWLINE, transfer.chunkLength, best * 1e-6);
+
+        transferFree(&transfer);
+        accumulatorFree(&acc);
+
+        if(chunkLength >= recordLength)
+          break;
+      }
+    }
+
+    // Close oscilloscope:
+    ObjClose(scp);
+    CHECK_LAST_STATUS();
+  }
+  else
+  {
+    fprintf(stderr, "No oscilloscope available with block measurement support!" NEWLINE);
+    status = EXIT_FAILURE;
+  }
+
+  // Exit library:
+  LibExit();
+
+  return status;
+}
@@ -0,0 +1,130 @@
+/**
+ * OutputFile.c
+ * @author Simon Collignon
+ *
+ * The counter is only a hint: the number is taken by the O_EXCL create, a
+ * stale or concurrently updated counter costs a few more attempts, not a
+ * shared file. The lock file doesn't depend on the extension of the output,
+ * so a csv run and a binary run can't both take a number.
+ */
+
+#include "OutputFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Utils.h" // for OS_WINDOWS and NEWLINE
+#ifdef OS_WINDOWS
+#  include <io.h>
+#  define OUTPUT_SEPARATOR "\\"
+#  define OUTPUT_MODE (_S_IREAD | _S_IWRITE)
+#else // POSIX
+#  include <unistd.h>
+#  define OUTPUT_SEPARATOR "/"
+#  define OUTPUT_MODE 0644
+#endif
+
+#define OUTPUT_PREFIX "record_"
+#define OUTPUT_LOCK ".lock"
+
+// Path of name in directory, the current directory when it is empty:
+static void outputPath(char* path, size_t size, const char* directory, const char* name)
+{
+  snprintf(path, size, "%s%s%s", directory, *directory ? OUTPUT_SEPARATOR : "", name);
+}
+
+// One past the highest record_<n> in directory, 0 for none:
+static bool8_t outputScan(const char* directory, uint64_t* next)
+{
+  DIR* dir = opendir(*directory ? directory : ".");
+  if(!dir)
+    return BOOL8_FALSE;
+
+  *next = 0;
+
+  for(struct dirent* entry; (entry = readdir(dir)); )
+  {
+    if(strncmp(entry->d_name, OUTPUT_PREFIX, strlen(OUTPUT_PREFIX)) != 0)
+      continue;
+
+    const char* digits = entry->d_name + strlen(OUTPUT_PREFIX);
+    if(*digits < '0' || *digits > '9')
+      continue;
+
+    uint64_t number = strtoull(digits, NULL, 10);
+    if(number >= *next)
+      *next = number + 1;
+  }
+
+  closedir(dir);
+  return BOOL8_TRUE;
+}
+
+static bool8_t outputExists(const char* stem, const char* extension)
+{
+  char path[OUTPUT_PATH_LENGTH];
+  struct stat info;
+
+  snprintf(path, sizeof(path), "%s%s", stem, extension);
+  return stat(path, &info) == 0;
+}
+
+bool8_t outputFileReserve(const char* directory, char* stem)
+{
+  char counterPath[OUTPUT_PATH_LENGTH];
+  char path[OUTPUT_PATH_LENGTH];
+  char name[64];
+  uint64_t number;
+
+  outputPath(counterPath, sizeof(counterPath), directory, OUTPUT_PREFIX "counter");
+  FILE* counter = fopen(counterPath, "r");
+  bool8_t counted = counter && fscanf(counter, "%" SCNu64, &number) == 1;
+
+  if(counter)
+    fclose(counter);
+
+  if(!counted && !outputScan(directory, &number))
+  {
+    fprintf(stderr, "Couldn't read the output directory: %s" NEWLINE, directory);
+    return BOOL8_FALSE;
+  }
+
+  // The create fails on an existing file, whoever made it:
+  for(;; number++)
+  {
+    snprintf(name, sizeof(name), OUTPUT_PREFIX "%" PRIu64, number);
+    outputPath(stem, OUTPUT_STEM_LENGTH, directory, name);
+    snprintf(path, sizeof(path), "%s" OUTPUT_LOCK, stem);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, OUTPUT_MODE);
+    if(fd >= 0)
+    {
+      close(fd);
+
+      // Outputs written before the lock files, the lock keeps the number taken:
+      if(!outputExists(stem, ".csv") && !outputExists(stem, ".bin"))
+        break;
+
+      continue;
+    }
+
+    if(errno != EEXIST)
+    {
+      fprintf(stderr, "Couldn't create file: %s" NEWLINE, path);
+      return BOOL8_FALSE;
+    }
+  }
+
+  counter = fopen(counterPath, "w");
+  if(counter)
+  {
+    fprintf(counter, "%" PRIu64 "\n", number + 1);
+    fclose(counter);
+  }
+
+  return BOOL8_TRUE;
+}
@@ -0,0 +1,30 @@
+/**
+ * OutputFile.h
+ * @author Simon Collignon
+ *
+ * Numbering of the output files, <directory>/record_<n>.csv or .bin, the
+ * snapshot, timing and archive files are named after them. The next number
+ * is kept in <directory>/record_counter, so a run doesn't open every earlier
+ * file to find a free one, and <directory>/record_<n>.lock is created
+ * exclusively, so two runs started at once can't pick the same number,
+ * whatever files they write.
+ */
+
+#ifndef _OUTPUTFILE_H_
+#define _OUTPUTFILE_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Config.h"
+
+// Bytes of <directory>/record_<n>, and of it with the longest suffix:
+#define OUTPUT_STEM_LENGTH (CONFIG_PATH_LENGTH + 32)
+#define OUTPUT_PATH_LENGTH (OUTPUT_STEM_LENGTH + 32)
+
+// Create the next free <directory>/record_<n>.lock, which is kept so every
+// file named after record_<n> stays the run's, and write <directory>/record_<n>
+// to stem, OUTPUT_STEM_LENGTH bytes. Without a counter the directory is
+// scanned once for the highest number in use:
+bool8_t outputFileReserve(const char* directory, char* stem);
+
+#endif
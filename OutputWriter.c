@@ -0,0 +1,141 @@
+/**
+ * OutputWriter.c
+ * @author Simon Collignon
+ *
+ * Every result is written by its own thread, started by parallelStart, the
+ * files don't share anything. The queue is a ring of the threads in flight,
+ * joined oldest first.
+ */
+
+#include "OutputWriter.h"
+#include <stdlib.h>
+#include "CsvOutput.h"
+#include "Utils.h" // for NEWLINE
+
+// Scale and write the data of job, then free it:
+static void outputWrite(OutputJob_t* job)
+{
+  uint16_t columnCount = csvColumnCount(job->data.channelCount, job->cycleErrors, job->blockErrors);
+  uint64_t binCount = job->data.length;
+
+  // Scale the sums to volts a few thousand samples at a time, all of them
+  // for the binary output, whose columns are written in one go:
+  const uint64_t rowCount = job->binary ? binCount : 4096;
+  float* values = malloc(sizeof(float) * columnCount * rowCount);
+  job->written = values != NULL;
+
+  if(values && job->binary)
+  {
+    job->binaryHeader.columnCount = columnCount;
+    csvColumns(&job->data, 0, binCount, job->cycleErrors, job->blockErrors, values, rowCount);
+    job->written = binaryWriteData(job->file, &job->binaryHeader, values);
+  }
+
+  // Write the data to csv, a row is timed by its sample in the cycle:
+  for(uint64_t bin = 0, rows; values && !job->binary && bin < binCount; bin += rows)
+  {
+    uint64_t sample;
+    rows = roiRun(&job->roi, job->cycleLength, bin, &sample);
+    rows = rows < rowCount ? rows : rowCount;
+    csvColumns(&job->data, bin, rows, job->cycleErrors, job->blockErrors, values, rowCount);
+    csvWriteRows(job->file, values, columnCount, rowCount, sample, rows, job->fs, job->timeColumn);
+  }
+
+  free(values);
+  job->written = fclose(job->file) == 0 && job->written;
+  timingMark(&job->timing, TIMING_WRITE);
+
+  if(job->written)
+    printf("Data written to: %s \n", job->filename);
+  else
+    fprintf(stderr, "Couldn't write the data to: %s" NEWLINE, job->filename);
+
+  // Per block phase durations next to the data:
+  if(!timingWriteLog(&job->timing, job->timingFilename))
+    fprintf(stderr, "Couldn't write timing log: %s" NEWLINE, job->timingFilename);
+
+  accumulatorFree(&job->data);
+  timingFree(&job->timing);
+}
+
+static void outputWriteTask(void* arg, unsigned index)
+{
+  (void) index;
+  outputWrite(arg);
+}
+
+bool8_t outputWriterInit(OutputWriter_t* writer, unsigned queueLength)
+{
+  writer->queueLength = queueLength;
+  writer->first = 0;
+  writer->count = 0;
+  writer->writtenCount = 0;
+  writer->failedCount = 0;
+  writer->jobs = queueLength ? calloc(queueLength, sizeof(OutputJob_t*)) : NULL;
+  writer->threads = queueLength ? calloc(queueLength, sizeof(ParallelThread_t*)) : NULL;
+
+  if(queueLength && (!writer->jobs || !writer->threads))
+  {
+    outputWriterFree(writer);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+// Wait for the oldest result in flight:
+static void outputWriterJoin(OutputWriter_t* writer)
+{
+  OutputJob_t* job = writer->jobs[writer->first];
+
+  parallelJoin(writer->threads[writer->first]);
+
+  if(job->written)
+    writer->writtenCount++;
+  else
+    writer->failedCount++;
+
+  free(job);
+  writer->first = (writer->first + 1) % writer->queueLength;
+  writer->count--;
+}
+
+void outputWriterSubmit(OutputWriter_t* writer, OutputJob_t* job)
+{
+  if(writer->queueLength == 0)
+  {
+    outputWrite(job);
+    if(job->written)
+      writer->writtenCount++;
+    else
+      writer->failedCount++;
+    free(job);
+    return;
+  }
+
+  // Back-pressure, the run waits rather than queue more results:
+  if(writer->count == writer->queueLength)
+    outputWriterJoin(writer);
+
+  unsigned slot = (writer->first + writer->count) % writer->queueLength;
+  writer->jobs[slot] = job;
+  writer->count++;
+  writer->threads[slot] = parallelStart(outputWriteTask, job);
+}
+
+void outputWriterFinish(OutputWriter_t* writer)
+{
+  while(writer->count > 0)
+  {
+    outputWriterJoin(writer);
+  }
+}
+
+void outputWriterFree(OutputWriter_t* writer)
+{
+  outputWriterFinish(writer);
+  free(writer->jobs);
+  free(writer->threads);
+  writer->jobs = NULL;
+  writer->threads = NULL;
+}
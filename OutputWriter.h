@@ -0,0 +1,66 @@
+/**
+ * OutputWriter.h
+ * @author Simon Collignon
+ *
+ * Background writing of the data section of the output files, so the next
+ * run starts acquiring while the previous result is formatted and flushed.
+ * The header is written by the run itself, it is small and needs the scope.
+ * At most queueLength results are written at once, the run after them waits
+ * for the oldest one, which bounds the memory the queued results hold.
+ */
+
+#ifndef _OUTPUTWRITER_H_
+#define _OUTPUTWRITER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "BinaryOutput.h"
+#include "OutputFile.h"
+#include "Parallel.h"
+#include "Roi.h"
+#include "Timing.h"
+
+typedef struct
+{
+  FILE* file;              // the header is written, the data follows
+  char filename[OUTPUT_PATH_LENGTH]; // of file, for the messages
+  char timingFilename[OUTPUT_PATH_LENGTH]; // per block phase durations, written after the data
+  bool8_t binary;          // file is a binary output, with binaryHeader at its start
+  BinaryHeader_t binaryHeader;
+  Accumulator_t data;      // result of the run, owned and freed by the writer
+  bool8_t cycleErrors;     // standard errors across cycles next to the means
+  bool8_t blockErrors;     // and across blocks
+  Roi_t roi;               // windows of the cycle the bins hold
+  uint64_t cycleLength;    // Sa, for the time of the bins
+  double fs;               // Sa/s, for the time column
+  bool8_t timeColumn;
+  Timing_t timing;         // of the run, owned by the writer, TIMING_WRITE lasts until the data is written
+  bool8_t written;         // set by the writer
+} OutputJob_t;
+
+typedef struct
+{
+  unsigned queueLength;     // results written at once, 0 to write them in the calling thread
+  OutputJob_t** jobs;       // queueLength in flight, oldest at first
+  ParallelThread_t** threads;
+  unsigned first;
+  unsigned count;
+  uint64_t writtenCount;
+  uint64_t failedCount;
+} OutputWriter_t;
+
+bool8_t outputWriterInit(OutputWriter_t* writer, unsigned queueLength);
+
+// Write the data of job, allocated with malloc, in the background. The
+// writer owns job from here on, waits for the oldest result first when
+// queueLength results are in flight:
+void outputWriterSubmit(OutputWriter_t* writer, OutputJob_t* job);
+
+// Wait until all submitted results are written:
+void outputWriterFinish(OutputWriter_t* writer);
+
+void outputWriterFree(OutputWriter_t* writer);
+
+#endif
@@ -0,0 +1,308 @@
+/**
+ * Parallel.c
+ * @author Simon Collignon
+ *
+ * parallelRun starts its threads per call: the fold is split once per run,
+ * where starting them costs a few tens of microseconds. The alignments split
+ * every chunk, hundreds of times per block, so their threads are kept in a
+ * pool and wait on a condition variable between calls.
+ */
+
+#include "Parallel.h"
+#include <stdlib.h>
+#include "Utils.h" // for OS_WINDOWS
+#ifdef OS_WINDOWS
+#  include <windows.h>
+#else // POSIX
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+struct ParallelThread
+{
+  ParallelTask_t task;
+  void* arg;
+  unsigned index;
+#ifdef OS_WINDOWS
+  HANDLE thread;
+#else // POSIX
+  pthread_t thread;
+#endif
+  int started;
+};
+
+#ifdef OS_WINDOWS
+typedef CRITICAL_SECTION ParallelMutex_t;
+typedef CONDITION_VARIABLE ParallelCondition_t;
+#  define parallelMutexInit(m) (InitializeCriticalSection(m), 1)
+#  define parallelMutexFree(m) DeleteCriticalSection(m)
+#  define parallelLock(m) EnterCriticalSection(m)
+#  define parallelUnlock(m) LeaveCriticalSection(m)
+#  define parallelConditionInit(c) (InitializeConditionVariable(c), 1)
+#  define parallelConditionFree(c)
+#  define parallelWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#  define parallelWakeAll(c) WakeAllConditionVariable(c)
+#else // POSIX
+typedef pthread_mutex_t ParallelMutex_t;
+typedef pthread_cond_t ParallelCondition_t;
+#  define parallelMutexInit(m) (pthread_mutex_init(m, NULL) == 0)
+#  define parallelMutexFree(m) pthread_mutex_destroy(m)
+#  define parallelLock(m) pthread_mutex_lock(m)
+#  define parallelUnlock(m) pthread_mutex_unlock(m)
+#  define parallelConditionInit(c) (pthread_cond_init(c, NULL) == 0)
+#  define parallelConditionFree(c) pthread_cond_destroy(c)
+#  define parallelWait(c, m) pthread_cond_wait(c, m)
+#  define parallelWakeAll(c) pthread_cond_broadcast(c)
+#endif
+
+struct ParallelPool
+{
+  unsigned workerCount;      // threads started, the caller is one more
+  ParallelThread_t* workers; // worker i runs index i + 1
+  ParallelMutex_t mutex;
+  ParallelCondition_t start; // a new call or the end of the pool
+  ParallelCondition_t done;  // the last worker finished the call
+  unsigned call;             // counts the calls, the workers wait for the next one
+  unsigned pending;          // workers still in the call
+  ParallelTask_t task;
+  void* arg;
+  unsigned count;
+  int stop;
+};
+
+#ifdef OS_WINDOWS
+static DWORD WINAPI parallelThreadMain(LPVOID param)
+#else // POSIX
+static void* parallelThreadMain(void* param)
+#endif
+{
+  ParallelThread_t* t = param;
+  t->task(t->arg, t->index);
+  return 0;
+}
+
+unsigned parallelCoreCount()
+{
+#ifdef OS_WINDOWS
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else // POSIX
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned) count : 1;
+#endif
+}
+
+static void parallelThreadStart(ParallelThread_t* t)
+{
+#ifdef OS_WINDOWS
+  t->thread = CreateThread(NULL, 0, parallelThreadMain, t, 0, NULL);
+  t->started = t->thread != NULL;
+#else // POSIX
+  t->started = pthread_create(&t->thread, NULL, parallelThreadMain, t) == 0;
+#endif
+}
+
+static void parallelThreadJoin(ParallelThread_t* t)
+{
+#ifdef OS_WINDOWS
+  WaitForSingleObject(t->thread, INFINITE);
+  CloseHandle(t->thread);
+#else // POSIX
+  pthread_join(t->thread, NULL);
+#endif
+}
+
+void parallelRun(ParallelTask_t task, void* arg, unsigned count)
+{
+  ParallelThread_t* threads = count > 1 ? calloc(count, sizeof(ParallelThread_t)) : NULL;
+
+  for(unsigned i = 1; threads && i < count; i++)
+  {
+    threads[i].task = task;
+    threads[i].arg = arg;
+    threads[i].index = i;
+    parallelThreadStart(&threads[i]);
+  }
+
+  if(count > 0)
+    task(arg, 0);
+
+  for(unsigned i = 1; i < count; i++)
+  {
+    if(!threads || !threads[i].started)
+    {
+      task(arg, i);
+      continue;
+    }
+
+    parallelThreadJoin(&threads[i]);
+  }
+
+  free(threads);
+}
+
+ParallelThread_t* parallelStart(ParallelTask_t task, void* arg)
+{
+  ParallelThread_t* thread = calloc(1, sizeof(ParallelThread_t));
+
+  if(thread)
+  {
+    thread->task = task;
+    thread->arg = arg;
+    parallelThreadStart(thread);
+  }
+
+  if(!thread || !thread->started)
+  {
+    free(thread);
+    task(arg, 0);
+    return NULL;
+  }
+
+  return thread;
+}
+
+void parallelJoin(ParallelThread_t* thread)
+{
+  if(!thread)
+    return;
+
+  parallelThreadJoin(thread);
+  free(thread);
+}
+
+static void parallelPoolWorker(void* arg, unsigned index)
+{
+  ParallelPool_t* pool = arg;
+  unsigned call = 0;
+
+  parallelLock(&pool->mutex);
+
+  for(;;)
+  {
+    while(pool->call == call && !pool->stop)
+    {
+      parallelWait(&pool->start, &pool->mutex);
+    }
+
+    if(pool->stop)
+      break;
+
+    call = pool->call;
+
+    if(index < pool->count)
+    {
+      parallelUnlock(&pool->mutex);
+      pool->task(pool->arg, index);
+      parallelLock(&pool->mutex);
+    }
+
+    if(--pool->pending == 0)
+      parallelWakeAll(&pool->done);
+  }
+
+  parallelUnlock(&pool->mutex);
+}
+
+ParallelPool_t* parallelPoolCreate(unsigned threadCount)
+{
+  ParallelPool_t* pool = threadCount > 1 ? calloc(1, sizeof(ParallelPool_t)) : NULL;
+  if(!pool)
+    return NULL;
+
+  pool->workers = calloc(threadCount - 1, sizeof(ParallelThread_t));
+
+  if(!pool->workers || !parallelMutexInit(&pool->mutex))
+  {
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+
+  if(!parallelConditionInit(&pool->start) || !parallelConditionInit(&pool->done))
+  {
+    parallelMutexFree(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+
+  // Fewer workers when a thread couldn't be started:
+  for(unsigned i = 0; i < threadCount - 1; i++)
+  {
+    ParallelThread_t* t = &pool->workers[pool->workerCount];
+    t->task = parallelPoolWorker;
+    t->arg = pool;
+    t->index = pool->workerCount + 1;
+    parallelThreadStart(t);
+
+    if(t->started)
+      pool->workerCount++;
+  }
+
+  return pool;
+}
+
+unsigned parallelPoolThreadCount(const ParallelPool_t* pool)
+{
+  return pool ? pool->workerCount + 1 : 1;
+}
+
+void parallelPoolRun(ParallelPool_t* pool, ParallelTask_t task, void* arg, unsigned count)
+{
+  unsigned workerCount = pool && count > 1 ? pool->workerCount : 0;
+
+  if(workerCount > 0)
+  {
+    parallelLock(&pool->mutex);
+    pool->task = task;
+    pool->arg = arg;
+    pool->count = count;
+    pool->pending = workerCount;
+    pool->call++;
+    parallelWakeAll(&pool->start);
+    parallelUnlock(&pool->mutex);
+  }
+
+  // Index 0 and those beyond the workers on the calling thread:
+  if(count > 0)
+    task(arg, 0);
+
+  for(unsigned i = workerCount + 1; i < count; i++)
+  {
+    task(arg, i);
+  }
+
+  if(workerCount > 0)
+  {
+    parallelLock(&pool->mutex);
+    while(pool->pending > 0)
+    {
+      parallelWait(&pool->done, &pool->mutex);
+    }
+    parallelUnlock(&pool->mutex);
+  }
+}
+
+void parallelPoolFree(ParallelPool_t* pool)
+{
+  if(!pool)
+    return;
+
+  parallelLock(&pool->mutex);
+  pool->stop = 1;
+  parallelWakeAll(&pool->start);
+  parallelUnlock(&pool->mutex);
+
+  for(unsigned i = 0; i < pool->workerCount; i++)
+  {
+    parallelThreadJoin(&pool->workers[i]);
+  }
+
+  parallelConditionFree(&pool->start);
+  parallelConditionFree(&pool->done);
+  parallelMutexFree(&pool->mutex);
+  free(pool->workers);
+  free(pool);
+}
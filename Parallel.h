@@ -0,0 +1,46 @@
+/**
+ * Parallel.h
+ * @author Simon Collignon
+ *
+ * Fork-join helper to spread a loop over the cores of the acquisition PC,
+ * and a pool of threads kept between calls for work split many times a run.
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+typedef void (*ParallelTask_t)(void* arg, unsigned index);
+
+typedef struct ParallelThread ParallelThread_t;
+typedef struct ParallelPool ParallelPool_t;
+
+// Number of cores available to the process:
+unsigned parallelCoreCount();
+
+// Run task(arg, index) for index 0 to count - 1, each on its own thread, and
+// return when all of them are done. The calling thread runs index 0, and
+// runs any index it couldn't start a thread for itself:
+void parallelRun(ParallelTask_t task, void* arg, unsigned count);
+
+// Run task(arg, 0) in the background, returns NULL when it couldn't start a
+// thread and ran the task itself:
+ParallelThread_t* parallelStart(ParallelTask_t task, void* arg);
+
+// Wait for a task started by parallelStart, thread may be NULL:
+void parallelJoin(ParallelThread_t* thread);
+
+// Start threadCount - 1 threads waiting for parallelPoolRun, returns NULL for
+// a threadCount of 1 or when the pool couldn't be allocated:
+ParallelPool_t* parallelPoolCreate(unsigned threadCount);
+
+// Threads a call runs on, the caller included, 1 for a NULL pool:
+unsigned parallelPoolThreadCount(const ParallelPool_t* pool);
+
+// As parallelRun on the threads of pool, the calling thread runs index 0 and
+// the indexes beyond the threads. pool may be NULL, it runs all of them:
+void parallelPoolRun(ParallelPool_t* pool, ParallelTask_t task, void* arg, unsigned count);
+
+// Stop and join the threads, pool may be NULL:
+void parallelPoolFree(ParallelPool_t* pool);
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * PhaseCorrection.c
+ * @author Simon Collignon
+ *
+ * The reference x[n] = A cos(omega n + phi) over the window gives
+ * I = sum x[n] cos(omega n) = A W / 2 cos(phi) and
+ * Q = sum x[n] sin(omega n) = -A W / 2 sin(phi), both vectorized dot
+ * products, so the estimate costs two passes over the window. A cycle that
+ * started d samples early has its phase advanced by omega d, delaying every
+ * channel of the cycle by d = (phi - phi0) / omega aligns it on the first one.
+ */
+
+#include "PhaseCorrection.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+bool8_t phaseCorrectionInit(PhaseCorrection_t* pc, uint16_t channelCount, uint64_t length, uint64_t chunkLength, uint16_t referenceChannel, double frequency, uint64_t window, unsigned threadCount)
+{
+  memset(pc, 0, sizeof(PhaseCorrection_t));
+
+  if(length == 0 || referenceChannel >= channelCount || frequency <= 0 || frequency >= 0.5)
+    return BOOL8_FALSE;
+
+  // Whole periods keep the image at -omega out of I and Q:
+  double period = 1 / frequency;
+  if(window > length || window == 0)
+    window = length;
+  if(window >= period)
+    window = (uint64_t) (floor(window / period) * period);
+
+  pc->channelCount = channelCount;
+  pc->length = length;
+  pc->referenceChannel = referenceChannel;
+  pc->omega = 2 * M_PI * frequency;
+  pc->window = window;
+  pc->maxCycleCount = chunkLength / length;
+  pc->pool = parallelPoolCreate(threadCount);
+  pc->cosine = malloc(sizeof(float) * window);
+  pc->sine = malloc(sizeof(float) * window);
+  pc->aligned = calloc(channelCount, sizeof(float*));
+  pc->delays = malloc(sizeof(double) * (pc->maxCycleCount > 0 ? pc->maxCycleCount : 1));
+  pc->kernels = kernels();
+  fractionalDelayInit(&pc->delay);
+
+  bool8_t ok = pc->cosine && pc->sine && pc->aligned && pc->delays;
+  for(uint16_t ch = 0; ok && ch < channelCount; ch++)
+  {
+    pc->aligned[ch] = malloc(sizeof(float) * pc->maxCycleCount * length);
+    ok = pc->aligned[ch] != NULL;
+  }
+
+  if(!ok || pc->maxCycleCount == 0)
+  {
+    phaseCorrectionFree(pc);
+    return BOOL8_FALSE;
+  }
+
+  for(uint64_t n = 0; n < window; n++)
+  {
+    pc->cosine[n] = (float) cos(pc->omega * n);
+    pc->sine[n] = (float) sin(pc->omega * n);
+  }
+
+  return BOOL8_TRUE;
+}
+
+float** phaseCorrectionApply(PhaseCorrection_t* pc, float** data, uint64_t position, uint64_t count)
+{
+  uint64_t cycleCount = count / pc->length;
+
+  if(position % pc->length != 0 || count % pc->length != 0 || cycleCount == 0 || cycleCount > pc->maxCycleCount)
+    return data;
+
+  for(uint64_t cycle = 0; cycle < cycleCount; cycle++)
+  {
+    const float* reference = data[pc->referenceChannel] + cycle * pc->length;
+    double i = pc->kernels->dotFloat(reference, pc->cosine, pc->window);
+    double q = pc->kernels->dotFloat(reference, pc->sine, pc->window);
+
+    // No tone, nothing to align on:
+    pc->delays[cycle] = 0;
+    if(i == 0 && q == 0)
+      continue;
+
+    double phase = atan2(-q, i);
+    if(!pc->havePhase)
+    {
+      pc->phase = phase;
+      pc->havePhase = BOOL8_TRUE;
+    }
+
+    double delay = remainder(phase - pc->phase, 2 * M_PI) / pc->omega;
+    pc->delays[cycle] = delay;
+
+    pc->cycleCount++;
+    pc->sumDelay2 += delay * delay;
+    if(fabs(delay) > pc->maxDelay)
+      pc->maxDelay = fabs(delay);
+  }
+
+  fractionalDelayApplyCycles(&pc->delay, pc->kernels, pc->aligned, data, pc->channelCount, pc->length, cycleCount, pc->delays, pc->pool);
+
+  return pc->aligned;
+}
+
+void phaseCorrectionFree(PhaseCorrection_t* pc)
+{
+  for(uint16_t ch = 0; pc->aligned && ch < pc->channelCount; ch++)
+  {
+    free(pc->aligned[ch]);
+  }
+
+  free(pc->cosine);
+  free(pc->sine);
+  free(pc->aligned);
+  free(pc->delays);
+  parallelPoolFree(pc->pool);
+  pc->cosine = NULL;
+  pc->sine = NULL;
+  pc->aligned = NULL;
+  pc->delays = NULL;
+  pc->pool = NULL;
+}
@@ -0,0 +1,54 @@
+/**
+ * PhaseCorrection.h
+ * @author Simon Collignon
+ *
+ * Coherent alignment of the FID cycles on a reference tone, e.g. a copy of
+ * the LO on a reference channel: the phase of the tone at the start of every
+ * cycle is measured by IQ demodulation and the cycle is delayed so that phase
+ * matches the one of the first cycle, before it is accumulated.
+ */
+
+#ifndef _PHASECORRECTION_H_
+#define _PHASECORRECTION_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "FractionalDelay.h"
+#include "Kernels.h"
+
+typedef struct
+{
+  uint16_t channelCount;
+  uint64_t length;           // samples per cycle, every cycle is aligned on its own
+  uint16_t referenceChannel; // channel holding the reference tone
+  double omega;              // rad per sample of the reference tone
+  uint64_t window;           // samples at the start of each cycle the phase is measured on
+  uint64_t maxCycleCount;    // cycles per chunk
+  ParallelPool_t* pool;      // threads applying the delays, NULL for the calling thread only
+  float* cosine;             // reference tone over the window
+  float* sine;
+  float** aligned;           // aligned chunk per channel
+  double* delays;            // Sa, of the cycles of the current chunk
+  bool8_t havePhase;
+  double phase;              // rad, of the first cycle, the later ones are aligned on it
+  FractionalDelay_t delay;
+  const Kernels_t* kernels;
+  uint64_t cycleCount;       // cycles aligned
+  double sumDelay2;          // Sa^2, sum of the squared delays
+  double maxDelay;           // Sa, largest delay magnitude
+} PhaseCorrection_t;
+
+// Allocate for chunks of up to chunkLength samples per channel. frequency is
+// the reference tone over the sample frequency, the window is cut to whole
+// periods of the tone and to the cycle length. Delays are only unambiguous
+// within half a period of the tone:
+bool8_t phaseCorrectionInit(PhaseCorrection_t* pc, uint16_t channelCount, uint64_t length, uint64_t chunkLength, uint16_t referenceChannel, double frequency, uint64_t window, unsigned threadCount);
+
+// Align samples [position, position + count) of a record, data holds one
+// float* per channel. Returns the aligned samples per channel, or data itself
+// when the chunk doesn't hold whole cycles:
+float** phaseCorrectionApply(PhaseCorrection_t* pc, float** data, uint64_t position, uint64_t count);
+
+void phaseCorrectionFree(PhaseCorrection_t* pc);
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * RawArchive.c
+ * @author Simon Collignon
+ *
+ * The file is allocated on the disk before the run, so archiving a block
+ * never waits for the file system to find room, and a full disk shows up
+ * before the acquisition starts. The kernel writes the mapped pages back
+ * while the next blocks are acquired.
+ */
+
+#include "RawArchive.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef OS_WINDOWS
+#  include <windows.h>
+#else // POSIX
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#ifdef OS_WINDOWS
+static bool8_t rawArchiveMap(RawArchive_t* archive, const char* filename)
+{
+  LARGE_INTEGER size;
+  size.QuadPart = (LONGLONG) archive->size;
+
+  archive->mapping = NULL;
+  archive->file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(archive->file == INVALID_HANDLE_VALUE)
+    return BOOL8_FALSE;
+
+  if(SetFilePointerEx(archive->file, size, NULL, FILE_BEGIN) && SetEndOfFile(archive->file))
+    archive->mapping = CreateFileMappingA(archive->file, NULL, PAGE_READWRITE, (DWORD) (archive->size >> 32), (DWORD) archive->size, NULL);
+
+  void* map = archive->mapping ? MapViewOfFile(archive->mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T) archive->size) : NULL;
+  if(!map)
+  {
+    if(archive->mapping)
+      CloseHandle(archive->mapping);
+    CloseHandle(archive->file);
+    DeleteFileA(filename);
+    return BOOL8_FALSE;
+  }
+
+  archive->header = map;
+  return BOOL8_TRUE;
+}
+#else // POSIX
+static bool8_t rawArchiveMap(RawArchive_t* archive, const char* filename)
+{
+  archive->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(archive->fd < 0)
+    return BOOL8_FALSE;
+
+  // Allocates the blocks on the disk, unlike ftruncate:
+  void* map = MAP_FAILED;
+  if(posix_fallocate(archive->fd, 0, (off_t) archive->size) == 0)
+    map = mmap(NULL, archive->size, PROT_READ | PROT_WRITE, MAP_SHARED, archive->fd, 0);
+
+  if(map == MAP_FAILED)
+  {
+    close(archive->fd);
+    unlink(filename);
+    return BOOL8_FALSE;
+  }
+
+  archive->header = map;
+  return BOOL8_TRUE;
+}
+#endif
+
+bool8_t rawArchiveOpen(RawArchive_t* archive, const char* filename, const Accumulator_t* acc, uint64_t recordLength, uint32_t segmentCount, uint64_t cycleLength, double fs, uint64_t blockCapacity)
+{
+  archive->header = NULL;
+
+  if(!acc->raw || acc->channelCount > RAW_ARCHIVE_MAX_CHANNELS || blockCapacity == 0)
+    return BOOL8_FALSE;
+
+  uint64_t blockSize = 0;
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    archive->channelOffset[ch] = blockSize;
+    blockSize += rawSampleSize(acc->formats[ch].type) * segmentCount * recordLength;
+  }
+
+  archive->blockCapacity = blockCapacity;
+  archive->size = RAW_ARCHIVE_ALIGNMENT + blockCapacity * blockSize;
+
+  if(!rawArchiveMap(archive, filename))
+  {
+    fprintf(stderr, "Couldn't preallocate %.3f GB for the raw archive: %s" NEWLINE, archive->size * 1e-9, filename);
+    return BOOL8_FALSE;
+  }
+
+  RawArchiveHeader_t* header = archive->header;
+  memset(header, 0, sizeof(RawArchiveHeader_t));
+  memcpy(header->magic, RAW_ARCHIVE_MAGIC, sizeof(header->magic));
+  header->version = RAW_ARCHIVE_VERSION;
+  header->dataOffset = RAW_ARCHIVE_ALIGNMENT;
+  header->blockSize = blockSize;
+  header->recordLength = recordLength;
+  header->segmentCount = segmentCount;
+  header->channelCount = acc->channelCount;
+  header->cycleLength = cycleLength;
+  header->fs = fs;
+
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    header->type[ch] = acc->formats[ch].type;
+    header->sampleSize[ch] = (uint32_t) rawSampleSize(acc->formats[ch].type);
+    header->zero[ch] = acc->formats[ch].zero;
+    header->scale[ch] = acc->formats[ch].scale;
+  }
+
+  archive->blocks = (char*) archive->header + RAW_ARCHIVE_ALIGNMENT;
+  return BOOL8_TRUE;
+}
+
+void** rawArchiveChunk(RawArchive_t* archive, unsigned slot, uint32_t segment, uint64_t start)
+{
+  const RawArchiveHeader_t* header = archive->header;
+  char* block = archive->blocks + header->blockCount * header->blockSize;
+  uint64_t sample = segment * header->recordLength + start;
+
+  for(uint16_t ch = 0; ch < header->channelCount; ch++)
+  {
+    archive->views[slot][ch] = block + archive->channelOffset[ch] + sample * header->sampleSize[ch];
+  }
+
+  return archive->views[slot];
+}
+
+bool8_t rawArchiveHasRoom(const RawArchive_t* archive)
+{
+  return archive->header->blockCount < archive->blockCapacity;
+}
+
+void rawArchiveEndBlock(RawArchive_t* archive)
+{
+  archive->header->blockCount++;
+}
+
+bool8_t rawArchiveFlush(RawArchive_t* archive)
+{
+#ifdef OS_WINDOWS
+  return FlushViewOfFile(archive->header, 0) && FlushFileBuffers(archive->file);
+#else // POSIX
+  return msync(archive->header, archive->size, MS_SYNC) == 0;
+#endif
+}
+
+bool8_t rawArchiveClose(RawArchive_t* archive)
+{
+  if(!archive->header)
+    return BOOL8_TRUE;
+
+  uint64_t size = RAW_ARCHIVE_ALIGNMENT + archive->header->blockCount * archive->header->blockSize;
+  bool8_t closed;
+
+#ifdef OS_WINDOWS
+  LARGE_INTEGER end;
+  end.QuadPart = (LONGLONG) size;
+
+  closed = UnmapViewOfFile(archive->header) != 0;
+  CloseHandle(archive->mapping);
+  closed = SetFilePointerEx(archive->file, end, NULL, FILE_BEGIN) && SetEndOfFile(archive->file) && closed;
+  closed = CloseHandle(archive->file) && closed;
+#else // POSIX
+  closed = munmap(archive->header, archive->size) == 0;
+  closed = ftruncate(archive->fd, (off_t) size) == 0 && closed;
+  closed = close(archive->fd) == 0 && closed;
+#endif
+
+  archive->header = NULL;
+  archive->blocks = NULL;
+  return closed;
+}
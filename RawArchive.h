@@ -0,0 +1,88 @@
+/**
+ * RawArchive.h
+ * @author Simon Collignon
+ *
+ * Archive of every raw block of a run, as the scope's codes, so it can be
+ * averaged again offline with other parameters. The file is preallocated
+ * for the run and mapped into memory, and the transfer hands the driver the
+ * place of each chunk in the mapping: the codes are written to the file by
+ * the driver itself and folded from there, without a copy.
+ *
+ * Layout:
+ *   RawArchiveHeader_t, zeros up to dataOffset, RAW_ARCHIVE_ALIGNMENT bytes
+ *   blockCount blocks, each the channels one after the other, each channel
+ *   segmentCount segments of recordLength codes of sampleSize bytes
+ *
+ * Only the whole cycles of a record are transferred, the codes after them
+ * are left 0.
+ */
+
+#ifndef _RAWARCHIVE_H_
+#define _RAWARCHIVE_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "Utils.h" // for OS_WINDOWS
+
+#define RAW_ARCHIVE_MAGIC "TPAVGRAW"
+#define RAW_ARCHIVE_VERSION 1
+#define RAW_ARCHIVE_ALIGNMENT 4096 // bytes, the blocks start on a page
+#define RAW_ARCHIVE_MAX_CHANNELS 8
+
+typedef struct
+{
+  char magic[8];          // RAW_ARCHIVE_MAGIC, not 0 terminated
+  uint32_t version;       // RAW_ARCHIVE_VERSION
+  uint32_t dataOffset;    // bytes from the start of the file to the first block
+  uint64_t blockCount;    // blocks archived
+  uint64_t blockSize;     // bytes per block, all channels
+  uint64_t recordLength;  // Sa per channel of a segment
+  uint32_t segmentCount;  // segments per block, 1 unless segmented
+  uint16_t channelCount;
+  uint16_t reserved;
+  uint64_t cycleLength;   // Sa
+  double fs;              // Sa/s
+  uint32_t type[RAW_ARCHIVE_MAX_CHANNELS];       // DATARAWTYPE_* per channel
+  uint32_t sampleSize[RAW_ARCHIVE_MAX_CHANNELS]; // bytes per code
+  int64_t zero[RAW_ARCHIVE_MAX_CHANNELS];        // code of 0 V
+  double scale[RAW_ARCHIVE_MAX_CHANNELS];        // volts per code
+} RawArchiveHeader_t;
+
+typedef struct
+{
+  RawArchiveHeader_t* header; // mapped at the start of the file
+  char* blocks;            // mapped, the first block
+  uint64_t blockCapacity;  // blocks the file was preallocated for
+  uint64_t channelOffset[RAW_ARCHIVE_MAX_CHANNELS]; // bytes in a block
+  void* views[2][RAW_ARCHIVE_MAX_CHANNELS]; // chunk destinations, two for async transfers
+  uint64_t size;           // bytes mapped
+#ifdef OS_WINDOWS
+  void* file;              // HANDLE of the file and of its mapping
+  void* mapping;
+#else // POSIX
+  int fd;
+#endif
+} RawArchive_t;
+
+// Create filename, preallocated for blockCapacity blocks of the raw codes of
+// acc, and map it:
+bool8_t rawArchiveOpen(RawArchive_t* archive, const char* filename, const Accumulator_t* acc, uint64_t recordLength, uint32_t segmentCount, uint64_t cycleLength, double fs, uint64_t blockCapacity);
+
+// Place of the chunk at start of segment in the block being archived, per
+// channel. slot 0 or 1 picks which of the two arrays is filled, so the
+// destinations of the chunk in flight stay valid:
+void** rawArchiveChunk(RawArchive_t* archive, unsigned slot, uint32_t segment, uint64_t start);
+
+// Whether the next block fits, and count it once it is transferred whole,
+// until then the next block is transferred over it:
+bool8_t rawArchiveHasRoom(const RawArchive_t* archive);
+void rawArchiveEndBlock(RawArchive_t* archive);
+
+// Write the mapped blocks back and flush them to the disk:
+bool8_t rawArchiveFlush(RawArchive_t* archive);
+
+// Unmap the file and cut it after the last block archived:
+bool8_t rawArchiveClose(RawArchive_t* archive);
+
+#endif
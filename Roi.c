@@ -0,0 +1,125 @@
+/**
+ * Roi.c
+ * @author Simon Collignon
+ */
+
+#include "Roi.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+bool8_t roiParse(Roi_t* roi, const char* text)
+{
+  memset(roi, 0, sizeof(Roi_t));
+
+  if(strcmp(text, "none") == 0)
+    return BOOL8_TRUE;
+
+  const char* s = text;
+
+  while(*s != '\0')
+  {
+    char* end;
+
+    if(roi->count == ROI_MAX_COUNT)
+      return BOOL8_FALSE;
+
+    // Through strtod, so 5e3 is accepted as well:
+    double start = strtod(s, &end);
+    if(end == s || *end != ':')
+      return BOOL8_FALSE;
+
+    s = end + 1;
+    double length = strtod(s, &end);
+    if(end == s || start < 0 || length < 1)
+      return BOOL8_FALSE;
+
+    uint64_t k = roi->count++;
+    roi->start[k] = (uint64_t) start;
+    roi->length[k] = (uint64_t) length;
+
+    if(k > 0 && roi->start[k] < roi->start[k - 1] + roi->length[k - 1])
+      return BOOL8_FALSE;
+
+    s = end;
+    while(*s == ' ')
+      s++;
+    if(*s == ',')
+      s++;
+    while(*s == ' ')
+      s++;
+  }
+
+  return BOOL8_TRUE;
+}
+
+void roiPrint(const Roi_t* roi, FILE* file)
+{
+  for(uint64_t k = 0; k < roi->count; k++)
+  {
+    fprintf(file, k ? ", %" PRIu64 ":%" PRIu64 : "%" PRIu64 ":%" PRIu64, roi->start[k], roi->length[k]);
+  }
+
+  if(roi->count == 0)
+    fprintf(file, "none");
+}
+
+uint64_t roiLength(const Roi_t* roi, uint64_t cycleLength)
+{
+  if(roi->count == 0)
+    return cycleLength;
+
+  uint64_t length = 0;
+  for(uint64_t k = 0; k < roi->count; k++)
+  {
+    length += roi->length[k];
+  }
+
+  return length;
+}
+
+uint64_t roiRun(const Roi_t* roi, uint64_t cycleLength, uint64_t bin, uint64_t* sample)
+{
+  if(roi->count == 0)
+  {
+    *sample = bin;
+    return cycleLength - bin;
+  }
+
+  for(uint64_t k = 0; k < roi->count; k++)
+  {
+    if(bin < roi->length[k])
+    {
+      *sample = roi->start[k] + bin;
+      return roi->length[k] - bin;
+    }
+
+    bin -= roi->length[k];
+  }
+
+  *sample = cycleLength;
+  return 0;
+}
+
+bool8_t roiFind(const Roi_t* roi, uint64_t start, uint64_t length, uint64_t* bin)
+{
+  if(roi->count == 0)
+  {
+    *bin = start;
+    return BOOL8_TRUE;
+  }
+
+  *bin = 0;
+  for(uint64_t k = 0; k < roi->count; k++)
+  {
+    if(start >= roi->start[k] && start + length <= roi->start[k] + roi->length[k])
+    {
+      *bin += start - roi->start[k];
+      return BOOL8_TRUE;
+    }
+
+    *bin += roi->length[k];
+  }
+
+  return BOOL8_FALSE;
+}
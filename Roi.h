@@ -0,0 +1,41 @@
+/**
+ * Roi.h
+ * @author Simon Collignon
+ *
+ * Regions of interest of a cycle: only these windows are transferred and
+ * summed, packed one after the other into the bins of the accumulator.
+ */
+
+#ifndef _ROI_H_
+#define _ROI_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+
+#define ROI_MAX_COUNT 8
+
+typedef struct
+{
+  uint64_t count;                  // windows, 0 keeps the whole cycle
+  uint64_t start[ROI_MAX_COUNT];   // Sa from the start of the cycle, ascending
+  uint64_t length[ROI_MAX_COUNT];  // Sa
+} Roi_t;
+
+// Parse "start:length, start:length", the windows ascending and apart, an
+// empty text or "none" for no windows:
+bool8_t roiParse(Roi_t* roi, const char* text);
+
+void roiPrint(const Roi_t* roi, FILE* file);
+
+// Samples in all windows, cycleLength without windows:
+uint64_t roiLength(const Roi_t* roi, uint64_t cycleLength);
+
+// Bins from bin to the end of its window, sample is set to the cycle sample of bin:
+uint64_t roiRun(const Roi_t* roi, uint64_t cycleLength, uint64_t bin, uint64_t* sample);
+
+// Bin of cycle sample start, BOOL8_FALSE unless [start, start + length) is
+// inside one window:
+bool8_t roiFind(const Roi_t* roi, uint64_t start, uint64_t length, uint64_t* bin);
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * ScopeEvents.c
+ * @author Simon Collignon
+ *
+ * LibTiePie signals an event object (an eventfd on Linux, an event handle on
+ * Windows) whenever an object event is queued. The queue is then drained with
+ * ObjGetEvent to find out what happened.
+ */
+
+#include "ScopeEvents.h"
+#include <stdio.h>
+#ifdef OS_WINDOWS
+#  include <windows.h>
+#else // POSIX
+#  include <errno.h>
+#  include <stdint.h>
+#  include <unistd.h>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#endif
+
+// Drain the event queue, returns BOOL8_TRUE when an event of interest is found:
+static bool8_t scopeEventsPoll(ScopeEvents_t* events, ScopeEvent_t* event)
+{
+  bool8_t dataReady = BOOL8_FALSE;
+  bool8_t dataOverflow = BOOL8_FALSE;
+  bool8_t removed = BOOL8_FALSE;
+  uint32_t id;
+  uint32_t value;
+
+  while(ObjGetEvent(events->scp, &id, &value))
+  {
+    if(id == LIBTIEPIE_EVENTID_OBJ_REMOVED)
+      removed = BOOL8_TRUE;
+    else if(id == LIBTIEPIE_EVENTID_SCP_DATAOVERFLOW)
+      dataOverflow = BOOL8_TRUE;
+    else if(id == LIBTIEPIE_EVENTID_SCP_DATAREADY)
+      dataReady = BOOL8_TRUE;
+  }
+
+  // Events queued before the event object was registered don't signal it:
+  if(removed || ObjIsRemoved(events->scp))
+  {
+    *event = SCOPE_EVENT_REMOVED;
+    return BOOL8_TRUE;
+  }
+
+  // Data of a stream that overflowed isn't contiguous anymore:
+  if(dataOverflow || ScpIsDataOverflow(events->scp))
+  {
+    *event = SCOPE_EVENT_DATA_OVERFLOW;
+    return BOOL8_TRUE;
+  }
+
+  if(dataReady || ScpIsDataReady(events->scp))
+  {
+    *event = SCOPE_EVENT_DATA_READY;
+    return BOOL8_TRUE;
+  }
+
+  return BOOL8_FALSE;
+}
+
+bool8_t scopeEventsOpen(ScopeEvents_t* events, LibTiePieHandle_t scp)
+{
+  events->scp = scp;
+
+#ifdef OS_WINDOWS
+  events->event = CreateEvent(NULL, FALSE, FALSE, NULL); // auto reset
+  if(!events->event)
+  {
+    fprintf(stderr, "CreateEvent failed: %lu" NEWLINE, (unsigned long) GetLastError());
+    return BOOL8_FALSE;
+  }
+
+  ObjSetEventEvent(scp, events->event);
+#else // POSIX
+  events->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(events->eventFd < 0)
+  {
+    perror("eventfd");
+    return BOOL8_FALSE;
+  }
+
+  events->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if(events->epollFd < 0)
+  {
+    perror("epoll_create1");
+    close(events->eventFd);
+    return BOOL8_FALSE;
+  }
+
+  struct epoll_event ev = {.events = EPOLLIN, .data.fd = events->eventFd};
+  if(epoll_ctl(events->epollFd, EPOLL_CTL_ADD, events->eventFd, &ev) < 0)
+  {
+    perror("epoll_ctl");
+    close(events->epollFd);
+    close(events->eventFd);
+    return BOOL8_FALSE;
+  }
+
+  ObjSetEventEvent(scp, events->eventFd);
+#endif
+
+  if(LibGetLastStatus() < LIBTIEPIESTATUS_SUCCESS)
+  {
+    scopeEventsClose(events);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+ScopeEvent_t scopeEventsWait(ScopeEvents_t* events, double timeout)
+{
+  const double deadline = monotonicSeconds() + timeout;
+  ScopeEvent_t event;
+
+  while(!scopeEventsPoll(events, &event))
+  {
+    double remaining = deadline - monotonicSeconds();
+    if(remaining <= 0)
+      return SCOPE_EVENT_TIMEOUT;
+
+#ifdef OS_WINDOWS
+    if(WaitForSingleObject(events->event, (DWORD) (remaining * 1e3) + 1) == WAIT_FAILED)
+      return SCOPE_EVENT_ERROR;
+#else // POSIX
+    struct epoll_event ev;
+    int n = epoll_wait(events->epollFd, &ev, 1, (int) (remaining * 1e3) + 1);
+    if(n < 0 && errno != EINTR)
+    {
+      perror("epoll_wait");
+      return SCOPE_EVENT_ERROR;
+    }
+
+    // Reset the eventfd counter, the queue itself is drained by the poll:
+    uint64_t count;
+    if(n > 0 && read(events->eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+      perror("read eventfd");
+      return SCOPE_EVENT_ERROR;
+    }
+#endif
+  }
+
+  return event;
+}
+
+void scopeEventsClose(ScopeEvents_t* events)
+{
+#ifdef OS_WINDOWS
+  ObjSetEventEvent(events->scp, NULL);
+  CloseHandle(events->event);
+#else // POSIX
+  ObjSetEventEvent(events->scp, -1);
+  close(events->epollFd);
+  close(events->eventFd);
+#endif
+}
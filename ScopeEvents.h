@@ -0,0 +1,45 @@
+/**
+ * ScopeEvents.h
+ * @author Simon Collignon
+ *
+ * Event driven waiting on oscilloscope notifications, so the acquisition loop
+ * resumes as soon as the data is ready instead of polling ScpIsDataReady.
+ */
+
+#ifndef _SCOPEEVENTS_H_
+#define _SCOPEEVENTS_H_
+
+#include <libtiepie.h>
+#include "Utils.h" // for OS_WINDOWS
+
+typedef enum
+{
+  SCOPE_EVENT_DATA_READY,
+  SCOPE_EVENT_DATA_OVERFLOW,
+  SCOPE_EVENT_REMOVED,
+  SCOPE_EVENT_TIMEOUT,
+  SCOPE_EVENT_ERROR
+} ScopeEvent_t;
+
+typedef struct
+{
+  LibTiePieHandle_t scp;
+#ifdef OS_WINDOWS
+  HANDLE event;
+#else // POSIX
+  int eventFd;
+  int epollFd;
+#endif
+} ScopeEvents_t;
+
+// Register an event object on the oscilloscope, returns BOOL8_FALSE on failure:
+bool8_t scopeEventsOpen(ScopeEvents_t* events, LibTiePieHandle_t scp);
+
+// Block until data is ready, a stream overflows, the device is removed or
+// timeout (seconds) elapsed:
+ScopeEvent_t scopeEventsWait(ScopeEvents_t* events, double timeout);
+
+// Unregister the event object and release it:
+void scopeEventsClose(ScopeEvents_t* events);
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * Snapshots.c
+ * @author Simon Collignon
+ *
+ * Taking a snapshot only scales the sums into a buffer, the much slower
+ * formatting and writing of the csv file run on their own thread. With
+ * growing cycle counts a write has long finished when the next snapshot is
+ * due, so the acquisition only waits for it in runs too short to matter.
+ */
+
+#include "Snapshots.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "CsvOutput.h"
+
+static uint64_t snapshotsCount(const Snapshots_t* snapshots, uint64_t index)
+{
+  return (uint64_t) llround(snapshots->first * pow(snapshots->ratio, (double) index));
+}
+
+bool8_t snapshotsInit(Snapshots_t* snapshots, const Accumulator_t* acc, uint64_t first, double ratio, const char* filename,
+  const Roi_t* roi, uint64_t cycleLength, double fs, bool8_t timeColumn)
+{
+  memset(snapshots, 0, sizeof(Snapshots_t));
+
+  if(first == 0 || !(ratio > 1))
+    return BOOL8_FALSE;
+
+  snapshots->first = first;
+  snapshots->ratio = ratio;
+  snapshots->next = first;
+  snapshots->channelCount = acc->channelCount;
+  snapshots->length = acc->length;
+  snapshots->errors = acc->sumSquares != NULL;
+  snapshots->fs = fs;
+  snapshots->timeColumn = timeColumn;
+  snapshots->roi = *roi;
+  snapshots->cycleLength = cycleLength;
+
+  // Strip the extension, the cycle count goes in front of it:
+  size_t prefixLength = strlen(filename);
+  if(prefixLength >= 4 && strcmp(filename + prefixLength - 4, ".csv") == 0)
+    prefixLength -= 4;
+
+  uint16_t columnCount = csvColumnCount(acc->channelCount, snapshots->errors, BOOL8_FALSE);
+  snapshots->prefix = malloc(prefixLength + 1);
+  snapshots->filename = malloc(prefixLength + 32);
+  snapshots->parts = calloc(acc->channelCount, sizeof(void*));
+  snapshots->values = malloc(sizeof(float) * columnCount * acc->length);
+  snapshots->noise = calloc(acc->channelCount, sizeof(double));
+
+  if(!snapshots->prefix || !snapshots->filename || !snapshots->parts || !snapshots->values || !snapshots->noise)
+  {
+    snapshotsFree(snapshots);
+    return BOOL8_FALSE;
+  }
+
+  memcpy(snapshots->prefix, filename, prefixLength);
+  snapshots->prefix[prefixLength] = '\0';
+
+  return BOOL8_TRUE;
+}
+
+static void snapshotsWriteTask(void* arg, unsigned index)
+{
+  Snapshots_t* snapshots = arg;
+  (void) index;
+
+  FILE* csv = fopen(snapshots->filename, "w");
+
+  if(!csv)
+  {
+    snapshots->failedCount++;
+    return;
+  }
+
+  fprintf(csv, "sampling rate [Sa/s]: %d \n", (int) snapshots->fs);
+  fprintf(csv, "number of averages: %" PRIu64 " \n", snapshots->count);
+  for(uint16_t ch = 0; snapshots->errors && ch < snapshots->channelCount; ch++)
+  {
+    fprintf(csv, "Ch%" PRIu16 " average noise rms [V]: %.8e \n", ch + 1, snapshots->noise[ch]);
+  }
+
+  uint16_t columnCount = csvColumnCount(snapshots->channelCount, snapshots->errors, BOOL8_FALSE);
+  csvWriteColumnNames(csv, snapshots->channelCount, snapshots->errors, BOOL8_FALSE);
+  csvWriteBins(csv, snapshots->values, columnCount, snapshots->length, &snapshots->roi, snapshots->cycleLength, snapshots->fs, snapshots->timeColumn);
+
+  if(ferror(csv))
+    snapshots->failedCount++;
+  else
+    snapshots->writtenCount++;
+
+  fclose(csv);
+}
+
+static void snapshotsTake(Snapshots_t* snapshots, const Accumulator_t* acc)
+{
+  // The buffers are still being written from:
+  snapshotsFinish(snapshots);
+
+  snapshots->count = acc->count;
+  csvColumns(acc, 0, acc->length, snapshots->errors, BOOL8_FALSE, snapshots->values, acc->length);
+  for(uint16_t ch = 0; snapshots->errors && ch < acc->channelCount; ch++)
+  {
+    snapshots->noise[ch] = accumulatorNoiseRms(acc, ch, 0, acc->length) / sqrt((double) acc->count);
+  }
+  sprintf(snapshots->filename, "%s_N%" PRIu64 ".csv", snapshots->prefix, acc->count);
+
+  snapshots->writer = parallelStart(snapshotsWriteTask, snapshots);
+
+  // A short chunk may have skipped some, they all grow strictly:
+  while(snapshots->next <= acc->count)
+  {
+    uint64_t next = snapshotsCount(snapshots, ++snapshots->index);
+    snapshots->next = next > snapshots->next ? next : snapshots->next + 1;
+  }
+}
+
+void snapshotsAccumulate(Snapshots_t* snapshots, Accumulator_t* acc, void** data, uint64_t position, uint64_t count)
+{
+  for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+  {
+    snapshots->parts[ch] = data[ch];
+  }
+
+  while(count > 0)
+  {
+    // Cycles end at multiples of length, the next snapshot is due at the end of cycle next - acc->count from here:
+    uint64_t cycles = (position + count) / acc->length - position / acc->length;
+    uint64_t n = count;
+
+    if(acc->count + cycles >= snapshots->next)
+      n = (position / acc->length + snapshots->next - acc->count) * acc->length - position;
+
+    accumulatorAdd(acc, snapshots->parts, position, n);
+
+    if(acc->count >= snapshots->next)
+      snapshotsTake(snapshots, acc);
+
+    for(uint16_t ch = 0; ch < acc->channelCount; ch++)
+    {
+      size_t size = acc->raw ? rawSampleSize(acc->formats[ch].type) : sizeof(float);
+      snapshots->parts[ch] = (char*) snapshots->parts[ch] + n * size;
+    }
+
+    position += n;
+    count -= n;
+  }
+}
+
+void snapshotsFinish(Snapshots_t* snapshots)
+{
+  parallelJoin(snapshots->writer);
+  snapshots->writer = NULL;
+}
+
+void snapshotsFree(Snapshots_t* snapshots)
+{
+  snapshotsFinish(snapshots);
+  free(snapshots->prefix);
+  free(snapshots->filename);
+  free(snapshots->parts);
+  free(snapshots->values);
+  free(snapshots->noise);
+  snapshots->prefix = NULL;
+  snapshots->filename = NULL;
+  snapshots->parts = NULL;
+  snapshots->values = NULL;
+  snapshots->noise = NULL;
+}
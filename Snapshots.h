@@ -0,0 +1,62 @@
+/**
+ * Snapshots.h
+ * @author Simon Collignon
+ *
+ * Snapshots of the running average at growing cycle counts, e.g. every power
+ * of ten, so one run gives the noise versus the number of averages. Every
+ * snapshot is written to its own csv file by a background thread while the
+ * acquisition goes on.
+ */
+
+#ifndef _SNAPSHOTS_H_
+#define _SNAPSHOTS_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "Parallel.h"
+#include "Roi.h"
+
+typedef struct
+{
+  uint64_t first;          // cycles in the first snapshot
+  double ratio;            // cycle count of snapshot k is first * ratio^k, rounded
+  uint64_t index;          // of the next snapshot
+  uint64_t next;           // cycle count of the next snapshot
+  uint16_t channelCount;
+  uint64_t length;         // samples per channel and cycle
+  bool8_t errors;          // standard errors across cycles next to the means
+  double fs;               // Sa/s, for the time column
+  bool8_t timeColumn;
+  Roi_t roi;               // windows of the cycle the bins hold
+  uint64_t cycleLength;    // Sa, for the time of the bins
+  char* prefix;            // output filename without .csv, "_N<count>.csv" is appended
+  void** parts;            // per channel data of the rest of a chunk split at a snapshot
+
+  // The snapshot being written, owned by the writer until it is joined:
+  ParallelThread_t* writer; // NULL when no write is in flight
+  float* values;           // columns of length samples, as in CsvOutput.h
+  double* noise;           // V, average noise rms per channel, with errors
+  uint64_t count;          // cycles averaged
+  char* filename;
+  uint64_t writtenCount;   // snapshots written
+  uint64_t failedCount;    // snapshots that couldn't be written
+} Snapshots_t;
+
+// Take snapshots of acc at first, first * ratio, ... cycles, ratio above 1.
+// They are named after filename, the output file of the whole run. acc holds
+// the windows roi of cycles of cycleLength samples:
+bool8_t snapshotsInit(Snapshots_t* snapshots, const Accumulator_t* acc, uint64_t first, double ratio, const char* filename,
+  const Roi_t* roi, uint64_t cycleLength, double fs, bool8_t timeColumn);
+
+// accumulatorAdd, split where acc holds the cycle count of the next snapshot
+// so the snapshot holds exactly that many. The write of the previous snapshot
+// is waited for before its buffers are reused:
+void snapshotsAccumulate(Snapshots_t* snapshots, Accumulator_t* acc, void** data, uint64_t position, uint64_t count);
+
+// Wait for the last write:
+void snapshotsFinish(Snapshots_t* snapshots);
+
+void snapshotsFree(Snapshots_t* snapshots);
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * SnrEstimator.c
+ * @author Simon Collignon
+ *
+ * The sums and the squares of the noise window are all the estimate needs,
+ * so an update costs a pass over the two windows, not over the data.
+ *
+ * The mean square of the average over the region of interest holds the noise
+ * of the average too, it is taken off so the SNR isn't biased up while the
+ * signal is still buried.
+ */
+
+#include "SnrEstimator.h"
+#include <string.h>
+#include <math.h>
+
+bool8_t snrEstimatorInit(SnrEstimator_t* snr, const Accumulator_t* acc, uint16_t channel, uint64_t noiseStart, uint64_t noiseLength,
+  uint64_t signalStart, uint64_t signalLength, double targetSnr, double targetStdError)
+{
+  memset(snr, 0, sizeof(SnrEstimator_t));
+
+  if(!accumulatorHasSquares(acc, noiseStart, noiseLength) || channel >= acc->channelCount || noiseLength == 0 ||
+     noiseStart + noiseLength > acc->length || signalStart + signalLength > acc->length)
+    return BOOL8_FALSE;
+
+  snr->channel = channel;
+  snr->noiseStart = noiseStart;
+  snr->noiseLength = noiseLength;
+  snr->signalStart = signalStart;
+  snr->signalLength = signalLength;
+  snr->targetSnr = targetSnr;
+  snr->targetStdError = targetStdError;
+
+  return BOOL8_TRUE;
+}
+
+bool8_t snrEstimatorUpdate(SnrEstimator_t* snr, const Accumulator_t* acc)
+{
+  snr->count = acc->count;
+
+  if(acc->count < 2)
+    return BOOL8_FALSE;
+
+  snr->noise = accumulatorNoiseRms(acc, snr->channel, snr->noiseStart, snr->noiseLength);
+  snr->stdError = snr->noise / sqrt((double) acc->count);
+
+  // The signal is measured from the level of the noise window:
+  double baseline = 0;
+  for(uint64_t i = snr->noiseStart; i < snr->noiseStart + snr->noiseLength; i++)
+  {
+    baseline += accumulatorMean(acc, snr->channel, i);
+  }
+  baseline /= snr->noiseLength;
+
+  double power = 0;
+  for(uint64_t i = snr->signalStart; i < snr->signalStart + snr->signalLength; i++)
+  {
+    double x = accumulatorMean(acc, snr->channel, i) - baseline;
+    power += x * x;
+  }
+  power = snr->signalLength ? power / snr->signalLength - snr->stdError * snr->stdError : 0;
+
+  snr->amplitude = power > 0 ? sqrt(power) : 0;
+  snr->snr = snr->stdError > 0 ? snr->amplitude / snr->stdError : 0;
+
+  snr->reached = (snr->targetSnr > 0 && snr->signalLength && snr->snr >= snr->targetSnr) ||
+                 (snr->targetStdError > 0 && snr->stdError <= snr->targetStdError);
+
+  return snr->reached;
+}
@@ -0,0 +1,46 @@
+/**
+ * SnrEstimator.h
+ * @author Simon Collignon
+ *
+ * Running estimate of the signal to noise ratio of the average, to stop a
+ * run once it is good enough: the noise is measured in a signal-free window
+ * of the cycle and the signal amplitude in a region of interest.
+ */
+
+#ifndef _SNRESTIMATOR_H_
+#define _SNRESTIMATOR_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+
+typedef struct
+{
+  uint16_t channel;
+  uint64_t noiseStart;     // Sa, signal-free window of the cycle
+  uint64_t noiseLength;
+  uint64_t signalStart;    // Sa, region of interest, 0 samples without SNR
+  uint64_t signalLength;
+  double targetSnr;        // stop once the SNR reaches this, 0 for no target
+  double targetStdError;   // V, stop once the noise of the average is below this, 0 for no target
+
+  // Last estimate:
+  uint64_t count;          // cycles averaged
+  double noise;            // V, rms over the noise window of the noise of a single cycle
+  double stdError;         // V, noise of the average
+  double amplitude;        // V, rms over the region of interest of the average, baseline and noise removed
+  double snr;              // amplitude over stdError
+  bool8_t reached;         // a target was reached
+} SnrEstimator_t;
+
+// Windows in samples of the cycles of acc, which must sum the squares of the
+// samples of the noise window, see accumulatorEnableWindowSquares. Returns
+// BOOL8_FALSE if a window isn't inside the cycle:
+bool8_t snrEstimatorInit(SnrEstimator_t* snr, const Accumulator_t* acc, uint16_t channel, uint64_t noiseStart, uint64_t noiseLength,
+  uint64_t signalStart, uint64_t signalLength, double targetSnr, double targetStdError);
+
+// Estimate from the sums of acc, only the windows are read. Returns
+// BOOL8_TRUE once a target is reached:
+bool8_t snrEstimatorUpdate(SnrEstimator_t* snr, const Accumulator_t* acc);
+
+#endif
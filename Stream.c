@@ -0,0 +1,79 @@
+/**
+ * Stream.c
+ * @author Simon Collignon
+ *
+ * There is no trigger in streaming mode: the cycles stay coherent because the
+ * FID source and the scope share the external clock, so the FID period is a
+ * whole number of samples and every stream record starts at the same phase
+ * as long as it holds whole cycles. A data overflow drops samples and breaks
+ * that phase, so the stream stops at the first one and keeps what was folded.
+ */
+
+#include "Stream.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "Utils.h"
+
+ScopeEvent_t streamAverage(LibTiePieHandle_t scp, ScopeEvents_t* events, Transfer_t* transfer, Accumulator_t* acc, uint64_t recordLength, uint64_t cycleCount, SnrEstimator_t* snr, double timeout, StreamStats_t* stats)
+{
+  memset(stats, 0, sizeof(StreamStats_t));
+
+  uint64_t cycleLength = transfer->roi ? transfer->cycleLength : acc->length;
+
+  if(recordLength % cycleLength != 0)
+  {
+    fprintf(stderr, "Stream record length %" PRIu64 " isn't a multiple of the cycle length %" PRIu64 NEWLINE, recordLength, cycleLength);
+    return SCOPE_EVENT_ERROR;
+  }
+
+  double fs = ScpGetSampleFrequency(scp);
+  // Rejected cycles count as acquired, as they do in block mode:
+  uint64_t target = acc->count + acc->saturatedCount + acc->glitchCount + cycleCount;
+  ScopeEvent_t event = SCOPE_EVENT_DATA_READY;
+
+  if(!ScpStart(scp))
+    return SCOPE_EVENT_ERROR;
+
+  double start = monotonicSeconds();
+  timingMark(transfer->timing, TIMING_ARM);
+
+  while(acc->count + acc->saturatedCount + acc->glitchCount < target)
+  {
+    // Stream records are timed like blocks:
+    timingEndBlock(transfer->timing);
+    timingBeginBlock(transfer->timing);
+
+    event = scopeEventsWait(events, timeout);
+    timingMark(transfer->timing, TIMING_WAIT);
+
+    if(event == SCOPE_EVENT_DATA_OVERFLOW)
+      stats->overflowCount++;
+
+    if(event != SCOPE_EVENT_DATA_READY)
+      break;
+
+    stats->sampleCount += transferBlock(transfer, scp, acc, recordLength, 1);
+    if(transfer->shortfall)
+      fprintf(stderr, "Record %" PRIu64 " transferred %" PRIu64 " Sa short!" NEWLINE, stats->recordCount, transfer->shortfall);
+    stats->recordCount++;
+    stats->elapsed = monotonicSeconds() - start;
+
+    if(transfer->stalled)
+    {
+      event = SCOPE_EVENT_ERROR;
+      break;
+    }
+
+    if(snr && snrEstimatorUpdate(snr, acc))
+      break;
+  }
+
+  ScpStop(scp);
+  timingEndBlock(transfer->timing);
+
+  if(stats->elapsed > 0)
+    stats->dutyCycle = stats->sampleCount / (fs * stats->elapsed);
+
+  return event;
+}
@@ -0,0 +1,35 @@
+/**
+ * Stream.h
+ * @author Simon Collignon
+ *
+ * Continuous averaging in streaming mode (MM_STREAM): the scope keeps
+ * sampling while the previous stream record is transferred and folded, so
+ * there is no arm or transfer dead time between records.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "ScopeEvents.h"
+#include "SnrEstimator.h"
+#include "Transfer.h"
+
+typedef struct
+{
+  uint64_t recordCount;   // stream records folded
+  uint64_t sampleCount;   // samples per channel folded
+  uint64_t overflowCount; // stream overflows, the stream stops at the first one
+  double elapsed;         // s, from ScpStart to the last record folded
+  double dutyCycle;       // fraction of the elapsed time covered by folded samples
+} StreamStats_t;
+
+// Stream records of recordLength samples, a multiple of the cycle length, into acc
+// until cycleCount more cycles are summed or rejected, or snr reaches its target unless
+// snr is NULL. Returns the event that ended the stream, SCOPE_EVENT_DATA_READY
+// when all cycles were summed or the target was reached:
+ScopeEvent_t streamAverage(LibTiePieHandle_t scp, ScopeEvents_t* events, Transfer_t* transfer, Accumulator_t* acc, uint64_t recordLength, uint64_t cycleCount, SnrEstimator_t* snr, double timeout, StreamStats_t* stats);
+
+#endif
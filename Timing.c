@@ -0,0 +1,167 @@
+/**
+ * Timing.c
+ * @author Simon Collignon
+ *
+ * Phases are timed by marks: each mark books the time since the previous
+ * one, so consecutive phases cover the run without gaps and without reading
+ * the clock twice per phase.
+ */
+
+#include "Timing.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "Utils.h"
+
+static const char* TimingPhaseNames[TIMING_PHASE_COUNT] = {"arm", "trigger wait", "transfer", "align", "accumulate", "fold", "write"};
+
+void timingInit(Timing_t* timing)
+{
+  memset(timing, 0, sizeof(Timing_t));
+}
+
+void timingStart(Timing_t* timing)
+{
+  timing->start = monotonicSeconds();
+  timing->mark = timing->start;
+}
+
+void timingBeginBlock(Timing_t* timing)
+{
+  if(!timing)
+    return;
+
+  if(timing->blockCount == timing->blockCapacity)
+  {
+    uint64_t capacity = timing->blockCapacity ? 2 * timing->blockCapacity : 256;
+    double* blocks = realloc(timing->blocks, sizeof(double) * TIMING_PHASE_COUNT * capacity);
+    if(!blocks)
+    {
+      timing->inBlock = BOOL8_FALSE;
+      return;
+    }
+
+    timing->blocks = blocks;
+    timing->blockCapacity = capacity;
+  }
+
+  memset(timing->blocks + TIMING_PHASE_COUNT * timing->blockCount, 0, sizeof(double) * TIMING_PHASE_COUNT);
+  timing->blockCount++;
+  timing->inBlock = BOOL8_TRUE;
+}
+
+void timingEndBlock(Timing_t* timing)
+{
+  if(timing)
+    timing->inBlock = BOOL8_FALSE;
+}
+
+void timingMark(Timing_t* timing, TimingPhase_t phase)
+{
+  if(!timing)
+    return;
+
+  double now = monotonicSeconds();
+  double duration = now - timing->mark;
+
+  timing->totals[phase] += duration;
+  if(timing->inBlock)
+    timing->blocks[TIMING_PHASE_COUNT * (timing->blockCount - 1) + phase] += duration;
+
+  timing->mark = now;
+}
+
+void timingStop(Timing_t* timing)
+{
+  timing->elapsed = monotonicSeconds() - timing->start;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+double timingPercentile(const Timing_t* timing, TimingPhase_t phase, double p)
+{
+  if(timing->blockCount == 0)
+    return 0;
+
+  double* values = malloc(sizeof(double) * timing->blockCount);
+  if(!values)
+    return 0;
+
+  for(uint64_t i = 0; i < timing->blockCount; i++)
+  {
+    values[i] = timing->blocks[TIMING_PHASE_COUNT * i + phase];
+  }
+
+  qsort(values, timing->blockCount, sizeof(double), compareDoubles);
+
+  // Nearest rank:
+  uint64_t rank = (uint64_t) (p / 100 * timing->blockCount + 0.5);
+  double value = values[rank > 0 ? (rank <= timing->blockCount ? rank - 1 : timing->blockCount - 1) : 0];
+
+  free(values);
+  return value;
+}
+
+void timingWriteHeader(const Timing_t* timing, FILE* csv, double acquired)
+{
+  fprintf(csv, "acquisition duty cycle [%%]: %f \n", timing->elapsed > 0 ? (float) (100 * acquired / timing->elapsed) : 0.0f);
+
+  for(int phase = TIMING_ARM; phase <= TIMING_ACCUMULATE; phase++)
+  {
+    fprintf(csv, "%s time per block p50/p90/p99/max [s]: %.3e/%.3e/%.3e/%.3e \n", TimingPhaseNames[phase],
+      timingPercentile(timing, phase, 50), timingPercentile(timing, phase, 90),
+      timingPercentile(timing, phase, 99), timingPercentile(timing, phase, 100));
+  }
+
+  fprintf(csv, "%s time [s]: %.3e \n", TimingPhaseNames[TIMING_FOLD], timing->totals[TIMING_FOLD]);
+}
+
+bool8_t timingWriteLog(const Timing_t* timing, const char* filename)
+{
+  FILE* log = fopen(filename, "w");
+
+  if(!log)
+  {
+    fprintf(stderr, "Couldn't open file: %s" NEWLINE, filename);
+    return BOOL8_FALSE;
+  }
+
+  fprintf(log, "elapsed time [s]: %f \n", timing->elapsed);
+  for(int phase = 0; phase < TIMING_PHASE_COUNT; phase++)
+  {
+    fprintf(log, "total %s time [s]: %f \n", TimingPhaseNames[phase], timing->totals[phase]);
+  }
+
+  fprintf(log, "Block");
+  for(int phase = TIMING_ARM; phase <= TIMING_ACCUMULATE; phase++)
+  {
+    fprintf(log, ",%s [s]", TimingPhaseNames[phase]);
+  }
+  fprintf(log, "\n");
+
+  for(uint64_t i = 0; i < timing->blockCount; i++)
+  {
+    fprintf(log, "%" PRIu64, i);
+    for(int phase = TIMING_ARM; phase <= TIMING_ACCUMULATE; phase++)
+    {
+      fprintf(log, ",%.6e", timing->blocks[TIMING_PHASE_COUNT * i + phase]);
+    }
+    fprintf(log, "\n");
+  }
+
+  fclose(log);
+  return BOOL8_TRUE;
+}
+
+void timingFree(Timing_t* timing)
+{
+  free(timing->blocks);
+  timing->blocks = NULL;
+  timing->blockCount = 0;
+  timing->blockCapacity = 0;
+}
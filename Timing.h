@@ -0,0 +1,67 @@
+/**
+ * Timing.h
+ * @author Simon Collignon
+ *
+ * Wall clock timing of the phases of an acquisition run, per block, to see
+ * where the time between two blocks goes.
+ */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libtiepie.h>
+
+typedef enum
+{
+  TIMING_ARM,         // ScpStart
+  TIMING_WAIT,        // waiting for the trigger and the data
+  TIMING_TRANSFER,    // transfer time not hidden behind the accumulation
+  TIMING_ALIGN,       // aligning the cycles on the reference tone or their leading edges
+  TIMING_ACCUMULATE,  // folding transferred chunks into the accumulator
+  TIMING_FOLD,        // folding the record sums into the cycle bins, once per run
+  TIMING_WRITE,       // writing the result, once per run
+  TIMING_PHASE_COUNT
+} TimingPhase_t;
+
+typedef struct
+{
+  double start;                       // s, monotonic time of timingStart
+  double mark;                        // s, monotonic time of the last mark
+  double elapsed;                     // s, from timingStart to timingStop
+  double totals[TIMING_PHASE_COUNT];  // s, per phase over the whole run
+  double* blocks;                     // s, TIMING_PHASE_COUNT durations per block
+  uint64_t blockCount;
+  uint64_t blockCapacity;
+  bool8_t inBlock;                    // marks also go to the last block
+} Timing_t;
+
+void timingInit(Timing_t* timing);
+
+// Start the run clock:
+void timingStart(Timing_t* timing);
+
+// Start a new block, the following marks are also added to it:
+void timingBeginBlock(Timing_t* timing);
+void timingEndBlock(Timing_t* timing);
+
+// Add the time since the previous mark to phase, timing may be NULL:
+void timingMark(Timing_t* timing, TimingPhase_t phase);
+
+// Stop the run clock:
+void timingStop(Timing_t* timing);
+
+// Percentile p (0 to 100) of the per block durations of phase:
+double timingPercentile(const Timing_t* timing, TimingPhase_t phase, double p);
+
+// Write the duty cycle, acquired (s of signal) over elapsed, and the per
+// phase percentiles as csv header lines:
+void timingWriteHeader(const Timing_t* timing, FILE* csv, double acquired);
+
+// Write the per block durations and run totals to a csv file:
+bool8_t timingWriteLog(const Timing_t* timing, const char* filename);
+
+void timingFree(Timing_t* timing);
+
+#endif
@@ -0,0 +1,360 @@
+/**
+ * Transfer.c
+ * @author Simon Collignon
+ *
+ * Transferring a 50 MSa record in one call streams it through DRAM twice:
+ * once when the driver writes it, once when it is folded. Reading windows of
+ * the record via the start index lets each chunk be folded while it is still
+ * in cache, and keeps the staging buffers small.
+ *
+ * In segmented mode every trigger captured one segment of recordLength
+ * samples. Each ScpGetData call returns the next segment, so a segment is
+ * read in a single call and folded like a record holding one cycle.
+ *
+ * In async mode two staging buffers alternate: while the CPU folds chunk N,
+ * the driver already writes chunk N + 1, so a block takes about the longest
+ * of transfer and fold instead of their sum.
+ *
+ * With regions of interest the windows of every cycle are read one call
+ * each, through the start index, into consecutive places of the staging
+ * buffers. Those calls are short, so they are made synchronously.
+ *
+ * With a raw archive the chunks go to their place in the mapped archive file
+ * instead of the staging buffers, and are folded from there.
+ */
+
+#include "Transfer.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include "Utils.h" // for NEWLINE
+
+static void** allocBuffers(const Accumulator_t* acc, uint64_t length)
+{
+  void** buffers = calloc(acc->channelCount, sizeof(void*));
+  for(uint16_t ch = 0; buffers && ch < acc->channelCount; ch++)
+  {
+    size_t size = acc->raw ? rawSampleSize(acc->formats[ch].type) : sizeof(float);
+    buffers[ch] = malloc(size * length);
+    if(!buffers[ch])
+    {
+      while(ch--)
+        free(buffers[ch]);
+      free(buffers);
+      return NULL;
+    }
+  }
+
+  return buffers;
+}
+
+static void freeBuffers(void** buffers, uint16_t channelCount)
+{
+  for(uint16_t ch = 0; buffers && ch < channelCount; ch++)
+  {
+    free(buffers[ch]);
+  }
+
+  free(buffers);
+}
+
+bool8_t transferInit(Transfer_t* transfer, const Accumulator_t* acc, uint64_t recordLength, uint64_t chunkLength, bool8_t async)
+{
+  transfer->channelCount = acc->channelCount;
+  transfer->raw = acc->raw;
+  transfer->chunkLength = chunkLength == 0 || chunkLength > recordLength ? recordLength : chunkLength;
+  transfer->async = async;
+  transfer->timing = NULL;
+  transfer->phaseCorrection = NULL;
+  transfer->triggerAlignment = NULL;
+  transfer->snapshots = NULL;
+  transfer->roi = NULL;
+  transfer->cycleLength = 0;
+  transfer->views = NULL;
+  transfer->archive = NULL;
+  transfer->timeout = 0;
+  transfer->shortfall = 0;
+  transfer->shortBlockCount = 0;
+  transfer->stalled = BOOL8_FALSE;
+  transfer->buffers = allocBuffers(acc, transfer->chunkLength);
+  transfer->spareBuffers = async ? allocBuffers(acc, transfer->chunkLength) : NULL;
+
+  if(!transfer->buffers || (async && !transfer->spareBuffers))
+  {
+    transferFree(transfer);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+bool8_t transferSetRoi(Transfer_t* transfer, const Roi_t* roi, uint64_t cycleLength)
+{
+  if(roi->count == 0 || transfer->chunkLength < roiLength(roi, cycleLength) ||
+     roi->start[roi->count - 1] + roi->length[roi->count - 1] > cycleLength)
+    return BOOL8_FALSE;
+
+  transfer->views = calloc(transfer->channelCount, sizeof(void*));
+  if(!transfer->views)
+    return BOOL8_FALSE;
+
+  transfer->roi = roi;
+  transfer->cycleLength = cycleLength;
+  return BOOL8_TRUE;
+}
+
+static void transferAccumulate(Transfer_t* transfer, Accumulator_t* acc, void** data, uint64_t start, uint64_t count)
+{
+  if(transfer->phaseCorrection && !transfer->raw)
+  {
+    data = (void**) phaseCorrectionApply(transfer->phaseCorrection, (float**) data, start, count);
+    timingMark(transfer->timing, TIMING_ALIGN);
+  }
+
+  if(transfer->triggerAlignment && !transfer->raw)
+  {
+    data = (void**) triggerAlignmentApply(transfer->triggerAlignment, (float**) data, start, count);
+    timingMark(transfer->timing, TIMING_ALIGN);
+  }
+
+  if(transfer->snapshots)
+    snapshotsAccumulate(transfer->snapshots, acc, data, start, count);
+  else
+    accumulatorAdd(acc, data, start, count);
+  timingMark(transfer->timing, TIMING_ACCUMULATE);
+}
+
+// Start index and sample count of chunk k, chunks never straddle segments:
+static void transferChunk(const Transfer_t* transfer, uint64_t length, uint64_t k, uint64_t* start, uint64_t* count)
+{
+  uint64_t chunksPerSegment = (length + transfer->chunkLength - 1) / transfer->chunkLength;
+
+  *start = (k % chunksPerSegment) * transfer->chunkLength;
+  *count = length - *start < transfer->chunkLength ? length - *start : transfer->chunkLength;
+}
+
+// Destination of chunk k, its place in archive or buffers without one:
+static void** transferTarget(const Transfer_t* transfer, RawArchive_t* archive, void** buffers, uint64_t length, uint64_t k)
+{
+  if(!archive)
+    return buffers;
+
+  uint64_t chunksPerSegment = (length + transfer->chunkLength - 1) / transfer->chunkLength;
+  uint64_t start, count;
+  transferChunk(transfer, length, k, &start, &count);
+
+  return rawArchiveChunk(archive, (unsigned) (k % 2), (uint32_t) (k / chunksPerSegment), start);
+}
+
+static uint64_t transferBlockSync(Transfer_t* transfer, LibTiePieHandle_t scp, Accumulator_t* acc, RawArchive_t* archive, uint64_t length, uint64_t chunkCount)
+{
+  uint64_t total = 0;
+
+  for(uint64_t k = 0; k < chunkCount; k++)
+  {
+    uint64_t start, count;
+    transferChunk(transfer, length, k, &start, &count);
+    void** buffers = transferTarget(transfer, archive, transfer->buffers, length, k);
+
+    if(transfer->raw)
+      count = ScpGetDataRaw(scp, buffers, transfer->channelCount, start, count);
+    else
+      count = ScpGetData(scp, (float**) buffers, transfer->channelCount, start, count);
+
+    timingMark(transfer->timing, TIMING_TRANSFER);
+
+    if(count == 0)
+      break;
+
+    transferAccumulate(transfer, acc, buffers, start, count);
+    total += count;
+  }
+
+  return total;
+}
+
+static bool8_t transferStartAsync(Transfer_t* transfer, LibTiePieHandle_t scp, void** buffers, uint64_t length, uint64_t k)
+{
+  uint64_t start, count;
+  transferChunk(transfer, length, k, &start, &count);
+
+  if(transfer->raw)
+    return ScpStartGetDataAsyncRaw(scp, buffers, transfer->channelCount, start, count);
+  else
+    return ScpStartGetDataAsync(scp, (float**) buffers, transfer->channelCount, start, count);
+}
+
+// Cancel the chunk in flight and wait for the driver to be done with its
+// buffers. When it isn't, they are left to it, see stalled:
+static void transferCancelAsync(Transfer_t* transfer, LibTiePieHandle_t scp)
+{
+  double deadline = monotonicSeconds() + (transfer->timeout > 0 ? transfer->timeout : TRANSFER_CANCEL_TIMEOUT);
+  ScpCancelGetDataAsync(scp);
+
+  while(!ScpIsGetDataAsyncCompleted(scp) && !ObjIsRemoved(scp) && monotonicSeconds() < deadline)
+  {
+  }
+
+  if(!ScpIsGetDataAsyncCompleted(scp))
+  {
+    fprintf(stderr, "Chunk transfer couldn't be cancelled, its buffers are left to the driver!" NEWLINE);
+    transfer->stalled = BOOL8_TRUE;
+  }
+}
+
+static uint64_t transferBlockAsync(Transfer_t* transfer, LibTiePieHandle_t scp, Accumulator_t* acc, RawArchive_t* archive, uint64_t length, uint64_t chunkCount)
+{
+  uint64_t total = 0;
+  void** buffers = transferTarget(transfer, archive, transfer->buffers, length, 0);
+
+  if(chunkCount == 0 || !transferStartAsync(transfer, scp, buffers, length, 0))
+    return 0;
+
+  for(uint64_t k = 0; k < chunkCount; k++)
+  {
+    // The fold of the previous chunk took most of the transfer time, so
+    // spinning here is short and wakes up without scheduler latency:
+    double deadline = transfer->timeout > 0 ? monotonicSeconds() + transfer->timeout : 0;
+    bool8_t late = BOOL8_FALSE;
+
+    while(!ScpIsGetDataAsyncCompleted(scp) && !ObjIsRemoved(scp) && !(late = deadline > 0 && monotonicSeconds() > deadline))
+    {
+    }
+
+    if(late)
+      fprintf(stderr, "Chunk not transferred within %f seconds!" NEWLINE, transfer->timeout);
+
+    // The driver must not write into the buffers once the block is given up:
+    if(late || ObjIsRemoved(scp))
+      transferCancelAsync(transfer, scp);
+
+    if(late || LibGetLastStatus() < LIBTIEPIESTATUS_SUCCESS || ObjIsRemoved(scp))
+      break;
+
+    // Start the next chunk in the spare buffers, then fold this one:
+    void** next = k + 1 < chunkCount ? transferTarget(transfer, archive, transfer->spareBuffers, length, k + 1) : NULL;
+    bool8_t started = next && transferStartAsync(transfer, scp, next, length, k + 1);
+    timingMark(transfer->timing, TIMING_TRANSFER);
+
+    uint64_t start, count;
+    transferChunk(transfer, length, k, &start, &count);
+    transferAccumulate(transfer, acc, buffers, start, count);
+    total += count;
+
+    if(!started)
+      break;
+
+    void** spare = transfer->buffers;
+    transfer->buffers = transfer->spareBuffers;
+    transfer->spareBuffers = spare;
+    buffers = next;
+  }
+
+  return total;
+}
+
+static uint64_t transferBlockRoi(Transfer_t* transfer, LibTiePieHandle_t scp, Accumulator_t* acc, uint64_t cycleCount)
+{
+  uint64_t total = 0;
+  uint64_t position = 0; // in the packed record
+  uint64_t binCount = roiLength(transfer->roi, transfer->cycleLength); // packed samples per cycle
+  uint64_t cyclesPerChunk = transfer->chunkLength / binCount;
+  bool8_t complete = BOOL8_TRUE;
+
+  for(uint64_t cycle = 0; cycle < cycleCount && complete; )
+  {
+    uint64_t offset = 0; // in the staging buffers
+
+    for(uint64_t n = 0; n < cyclesPerChunk && cycle < cycleCount && complete; n++, cycle++)
+    {
+      for(uint64_t k = 0; k < transfer->roi->count && complete; k++)
+      {
+        for(uint16_t ch = 0; ch < transfer->channelCount; ch++)
+        {
+          size_t size = transfer->raw ? rawSampleSize(acc->formats[ch].type) : sizeof(float);
+          transfer->views[ch] = (char*) transfer->buffers[ch] + offset * size;
+        }
+
+        uint64_t start = cycle * transfer->cycleLength + transfer->roi->start[k];
+        uint64_t count = transfer->roi->length[k];
+
+        if(transfer->raw)
+          count = ScpGetDataRaw(scp, transfer->views, transfer->channelCount, start, count);
+        else
+          count = ScpGetData(scp, (float**) transfer->views, transfer->channelCount, start, count);
+
+        complete = count == transfer->roi->length[k];
+        offset += count;
+      }
+    }
+
+    timingMark(transfer->timing, TIMING_TRANSFER);
+
+    // Only the cycles read completely:
+    offset -= offset % binCount;
+
+    if(offset > 0)
+    {
+      transferAccumulate(transfer, acc, transfer->buffers, position, offset);
+      position += offset;
+      total += offset / binCount * transfer->cycleLength;
+    }
+  }
+
+  return total;
+}
+
+// Keep what the block's samples per channel lack of expected:
+static uint64_t transferEndBlock(Transfer_t* transfer, uint64_t total, uint64_t expected)
+{
+  transfer->shortfall = total < expected ? expected - total : 0;
+  if(transfer->shortfall)
+    transfer->shortBlockCount++;
+
+  return total;
+}
+
+uint64_t transferBlock(Transfer_t* transfer, LibTiePieHandle_t scp, Accumulator_t* acc, uint64_t recordLength, uint32_t segmentCount)
+{
+  if(transfer->stalled)
+    return transferEndBlock(transfer, 0, segmentCount * recordLength);
+
+  if(transfer->roi)
+  {
+    uint64_t cycleCount = segmentCount * (recordLength / transfer->cycleLength);
+    return transferEndBlock(transfer, transferBlockRoi(transfer, scp, acc, cycleCount), cycleCount * transfer->cycleLength);
+  }
+
+  // Only whole cycles, a partial one would bias the first bins:
+  uint64_t length = recordLength - recordLength % acc->length;
+  uint64_t chunkCount = segmentCount * ((length + transfer->chunkLength - 1) / transfer->chunkLength);
+
+  // The blocks after a full archive are only averaged:
+  RawArchive_t* archive = transfer->archive && rawArchiveHasRoom(transfer->archive) ? transfer->archive : NULL;
+  uint64_t total;
+
+  if(transfer->async)
+    total = transferBlockAsync(transfer, scp, acc, archive, length, chunkCount);
+  else
+    total = transferBlockSync(transfer, scp, acc, archive, length, chunkCount);
+
+  // A short block isn't archived, the next one is transferred over it:
+  transferEndBlock(transfer, total, segmentCount * length);
+  if(archive && !transfer->shortfall)
+    rawArchiveEndBlock(archive);
+
+  return total;
+}
+
+void transferFree(Transfer_t* transfer)
+{
+  // Leaked rather than freed under the driver:
+  if(transfer->stalled)
+    return;
+
+  freeBuffers(transfer->buffers, transfer->channelCount);
+  freeBuffers(transfer->spareBuffers, transfer->channelCount);
+  free(transfer->views);
+  transfer->buffers = NULL;
+  transfer->spareBuffers = NULL;
+  transfer->views = NULL;
+}
@@ -0,0 +1,70 @@
+/**
+ * Transfer.h
+ * @author Simon Collignon
+ *
+ * Transfer of a measured block from the oscilloscope into an accumulator,
+ * in chunks small enough to stay in cache while they are folded. Optionally
+ * the next chunk is transferred while the current one is folded.
+ */
+
+#ifndef _TRANSFER_H_
+#define _TRANSFER_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "Accumulator.h"
+#include "PhaseCorrection.h"
+#include "RawArchive.h"
+#include "Roi.h"
+#include "Snapshots.h"
+#include "Timing.h"
+#include "TriggerAlignment.h"
+
+// Samples per channel and chunk, 256 KiB of 16 bit raw codes fit in L2 cache.
+// Run OscilloscopeChunkBenchmark to retune it on the acquisition PC.
+#define TRANSFER_DEFAULT_CHUNK_LENGTH 131072
+#define TRANSFER_CANCEL_TIMEOUT 1.0 // s, for a cancelled async chunk without a timeout
+
+typedef struct
+{
+  uint16_t channelCount;
+  bool8_t raw;
+  uint64_t chunkLength;  // samples per channel and ScpGetData call
+  bool8_t async;         // overlap transfer and fold with ScpStartGetDataAsync
+  void** buffers;        // staging buffer per channel, chunkLength samples
+  void** spareBuffers;   // second staging buffer per channel, async only
+  Timing_t* timing;      // transfer and accumulate phases are marked here, may be NULL
+  PhaseCorrection_t* phaseCorrection; // aligns the cycles of float chunks before they are accumulated, may be NULL
+  TriggerAlignment_t* triggerAlignment; // aligns them on their leading edges after that, may be NULL
+  Snapshots_t* snapshots; // snapshots of the accumulator taken as cycles are added, may be NULL
+  const Roi_t* roi;      // only these windows of every cycle are transferred, packed into the bins, may be NULL
+  uint64_t cycleLength;  // samples per cycle in the record, with roi
+  void** views;          // per channel position in the staging buffers, with roi
+  double timeout;        // s, an async chunk not transferred within it is given up, 0 for no limit
+  uint64_t shortfall;    // samples per channel missing from the last block, 0 when it was transferred whole
+  uint64_t shortBlockCount; // blocks transferred only in part
+  bool8_t stalled;       // an async chunk couldn't be cancelled, the driver may still write the buffers
+                         // or the archive, so no block is transferred any more and nothing is freed
+  RawArchive_t* archive; // raw blocks are transferred into it instead of the staging buffers while it has room, without roi,
+                         // short blocks are averaged but not archived, may be NULL
+} Transfer_t;
+
+// Allocate staging buffers matching the sample format of acc, a chunkLength
+// of 0 or above recordLength transfers the whole record at once:
+bool8_t transferInit(Transfer_t* transfer, const Accumulator_t* acc, uint64_t recordLength, uint64_t chunkLength, bool8_t async);
+
+// Only transfer the windows of roi of every cycle of cycleLength samples,
+// acc holds the windows packed. A chunk holds whole cycles, so chunkLength
+// must be at least the length of the windows. Not for segmented blocks:
+bool8_t transferSetRoi(Transfer_t* transfer, const Roi_t* roi, uint64_t cycleLength);
+
+// Transfer the whole cycles of every segment of a measured block and fold
+// them into acc, returns the number of samples per channel of the record
+// they cover. A failed or timed out chunk ends the block, what is missing is
+// left in shortfall, and a timed out one is cancelled. Segmented blocks need
+// a chunkLength of at least recordLength:
+uint64_t transferBlock(Transfer_t* transfer, LibTiePieHandle_t scp, Accumulator_t* acc, uint64_t recordLength, uint32_t segmentCount);
+
+void transferFree(Transfer_t* transfer);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * TriggerAlignment.c
+ * @author Simon Collignon
+ *
+ * The delays are estimated cycle after cycle on the calling thread: the
+ * correlation of the edge at the 2 maxLag + 1 integer lags is a handful of
+ * dot products, the peak is refined by a parabola through its neighbours,
+ * and the aligned edge is added to the template before the next cycle. The
+ * template only depends on the data, so the result doesn't depend on the
+ * chunk length nor on the thread count.
+ *
+ * Delaying the whole cycles is the expensive part, it is spread over the
+ * threads by fractionalDelayApplyCycles.
+ */
+
+#include "TriggerAlignment.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+bool8_t triggerAlignmentInit(TriggerAlignment_t* ta, uint16_t channelCount, uint64_t length, uint64_t chunkLength, uint16_t channel, uint64_t edge, uint64_t maxLag, unsigned threadCount)
+{
+  memset(ta, 0, sizeof(TriggerAlignment_t));
+
+  if(edge > length)
+    edge = length;
+
+  if(length == 0 || channel >= channelCount || maxLag == 0 || edge < 4 * maxLag)
+    return BOOL8_FALSE;
+
+  ta->channelCount = channelCount;
+  ta->length = length;
+  ta->channel = channel;
+  ta->edge = edge;
+  ta->maxLag = maxLag;
+  ta->maxCycleCount = chunkLength / length;
+  ta->pool = parallelPoolCreate(threadCount);
+  ta->aligned = calloc(channelCount, sizeof(float*));
+  ta->templateSum = calloc(edge, sizeof(float));
+  ta->alignedEdge = malloc(sizeof(float) * edge);
+  ta->delays = malloc(sizeof(double) * (ta->maxCycleCount > 0 ? ta->maxCycleCount : 1));
+  ta->kernels = kernels();
+  fractionalDelayInit(&ta->delay);
+
+  bool8_t ok = ta->aligned && ta->templateSum && ta->alignedEdge && ta->delays;
+  for(uint16_t ch = 0; ok && ch < channelCount; ch++)
+  {
+    ta->aligned[ch] = malloc(sizeof(float) * ta->maxCycleCount * length);
+    ok = ta->aligned[ch] != NULL;
+  }
+
+  if(!ok || ta->maxCycleCount == 0)
+  {
+    triggerAlignmentFree(ta);
+    return BOOL8_FALSE;
+  }
+
+  return BOOL8_TRUE;
+}
+
+// Delay in samples of an edge against the template:
+static double triggerAlignmentEstimate(const TriggerAlignment_t* ta, const float* edge)
+{
+  int64_t maxLag = (int64_t) ta->maxLag;
+  uint64_t count = ta->edge - 2 * ta->maxLag;
+  const float* reference = ta->templateSum + maxLag;
+  double best = -INFINITY;
+  double before = 0;
+  double after = 0;
+  int64_t peak = 0;
+  double previous = 0;
+
+  // edge[n + lag] matches template[n] when the cycle started -lag samples early:
+  for(int64_t lag = -maxLag; lag <= maxLag; lag++)
+  {
+    double c = ta->kernels->dotFloat(reference, edge + maxLag + lag, count);
+
+    if(c > best)
+    {
+      best = c;
+      peak = lag;
+      before = previous;
+    }
+    else if(lag == peak + 1)
+    {
+      after = c;
+    }
+
+    previous = c;
+  }
+
+  // Parabola through the peak and its neighbours, not at the ends of the search:
+  double offset = 0;
+  double curvature = before - 2 * best + after;
+  if(peak > -maxLag && peak < maxLag && curvature < 0)
+    offset = 0.5 * (before - after) / curvature;
+
+  return -(peak + offset);
+}
+
+float** triggerAlignmentApply(TriggerAlignment_t* ta, float** data, uint64_t position, uint64_t count)
+{
+  uint64_t cycleCount = count / ta->length;
+
+  if(position % ta->length != 0 || count % ta->length != 0 || cycleCount == 0 || cycleCount > ta->maxCycleCount)
+    return data;
+
+  for(uint64_t cycle = 0; cycle < cycleCount; cycle++)
+  {
+    const float* edge = data[ta->channel] + cycle * ta->length;
+    double delay = ta->templateCount ? triggerAlignmentEstimate(ta, edge) : 0;
+
+    fractionalDelayApply(&ta->delay, ta->kernels, ta->alignedEdge, edge, ta->length, delay, 0, ta->edge);
+    ta->kernels->addFloat(ta->templateSum, ta->alignedEdge, ta->edge);
+    ta->templateCount++;
+    ta->delays[cycle] = delay;
+
+    ta->cycleCount++;
+    ta->sumDelay2 += delay * delay;
+    if(fabs(delay) > ta->maxDelay)
+      ta->maxDelay = fabs(delay);
+  }
+
+  fractionalDelayApplyCycles(&ta->delay, ta->kernels, ta->aligned, data, ta->channelCount, ta->length, cycleCount, ta->delays, ta->pool);
+
+  return ta->aligned;
+}
+
+void triggerAlignmentFree(TriggerAlignment_t* ta)
+{
+  for(uint16_t ch = 0; ta->aligned && ch < ta->channelCount; ch++)
+  {
+    free(ta->aligned[ch]);
+  }
+
+  free(ta->aligned);
+  free(ta->templateSum);
+  free(ta->alignedEdge);
+  free(ta->delays);
+  parallelPoolFree(ta->pool);
+  ta->aligned = NULL;
+  ta->templateSum = NULL;
+  ta->alignedEdge = NULL;
+  ta->delays = NULL;
+  ta->pool = NULL;
+}
@@ -0,0 +1,51 @@
+/**
+ * TriggerAlignment.h
+ * @author Simon Collignon
+ *
+ * Sub-sample alignment of the FID cycles against external trigger jitter:
+ * the leading edge of every cycle is cross-correlated with a running template,
+ * the sum of the aligned edges so far, and every channel of the cycle is
+ * delayed by the fractional lag of the correlation peak.
+ */
+
+#ifndef _TRIGGERALIGNMENT_H_
+#define _TRIGGERALIGNMENT_H_
+
+#include <stdint.h>
+#include <libtiepie.h>
+#include "FractionalDelay.h"
+#include "Kernels.h"
+
+typedef struct
+{
+  uint16_t channelCount;
+  uint64_t length;          // samples per cycle
+  uint16_t channel;         // channel whose leading edge is matched
+  uint64_t edge;            // samples at the start of a cycle that are correlated
+  uint64_t maxLag;          // Sa, largest delay searched either way
+  uint64_t maxCycleCount;   // cycles per chunk
+  ParallelPool_t* pool;     // threads applying the delays, NULL for the calling thread only
+  float** aligned;          // aligned chunk per channel
+  float* templateSum;       // sum of the aligned edges so far
+  float* alignedEdge;       // aligned edge of the current cycle
+  double* delays;           // Sa, of the cycles of the current chunk
+  uint64_t templateCount;   // edges summed in the template
+  FractionalDelay_t delay;
+  const Kernels_t* kernels;
+  uint64_t cycleCount;      // cycles aligned
+  double sumDelay2;         // Sa^2, sum of the squared delays
+  double maxDelay;          // Sa, largest delay magnitude
+} TriggerAlignment_t;
+
+// Allocate for chunks of up to chunkLength samples per channel, edge must
+// hold at least 4 maxLag samples and is cut to the cycle length:
+bool8_t triggerAlignmentInit(TriggerAlignment_t* ta, uint16_t channelCount, uint64_t length, uint64_t chunkLength, uint16_t channel, uint64_t edge, uint64_t maxLag, unsigned threadCount);
+
+// Align samples [position, position + count) of a record, data holds one
+// float* per channel. Returns the aligned samples per channel, or data itself
+// when the chunk doesn't hold whole cycles:
+float** triggerAlignmentApply(TriggerAlignment_t* ta, float** data, uint64_t position, uint64_t count);
+
+void triggerAlignmentFree(TriggerAlignment_t* ta);
+
+#endif
@@ -14,6 +14,7 @@
 #  include <unistd.h>
 #  include <stdio.h>
 #  include <termios.h>
+#  include <time.h>
 #endif
 
 void sleepMiliSeconds(unsigned int ms)
@@ -25,6 +26,20 @@ void sleepMiliSeconds(unsigned int ms)
 #endif
 }
 
+double monotonicSeconds()
+{
+#ifdef OS_WINDOWS
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double) counter.QuadPart / frequency.QuadPart;
+#else // POSIX
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
 void waitForKeyStroke()
 {
 #ifdef OS_WINDOWS
@@ -17,6 +17,7 @@
 #endif
 
 void sleepMiliSeconds(unsigned int ms);
+double monotonicSeconds(); // seconds since an arbitrary, fixed point in time
 void waitForKeyStroke();
 
 #endif
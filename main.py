@@ -15,6 +15,98 @@ from matplotlib import pyplot as plt
 #     'legend.shadow': False
 # })
 
+# Header of the .bin files written with binaryOutput = true, see BinaryOutput.h:
+BINARY_HEADER = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('data_offset', '<u4'),
+    ('text_length', '<u8'),
+    ('row_count', '<u8'),
+    ('column_count', '<u2'),
+    ('channel_count', '<u2'),
+    ('roi_count', '<u2'),
+    ('reserved', '<u2'),
+    ('cycle_length', '<u8'),
+    ('average_count', '<u8'),
+    ('fs', '<f8'),
+    ('roi_start', '<u8', (8,)),
+    ('roi_length', '<u8', (8,)),
+])
+
+
+def read_binary(filepath):
+    ''' returns the header, the csv header lines and the columns of a .bin
+    file, the columns mapped from the file rather than read. '''
+
+    header = np.fromfile(filepath, dtype=BINARY_HEADER, count=1)[0]
+    if header['magic'] != b'TPAVGBIN' or header['version'] != 1:
+        raise ValueError(f'{filepath} is not a binary record')
+
+    with open(filepath, 'rb') as my_file:
+        my_file.seek(BINARY_HEADER.itemsize)
+        lines = my_file.read(int(header['text_length'])).decode().splitlines()
+
+    columns = np.memmap(filepath, dtype='<f4', mode='r', offset=int(header['data_offset']),
+                        shape=(int(header['column_count']), int(header['row_count'])))
+
+    # sample of each row in the cycle, the rows of the regions of interest follow each other:
+    if header['roi_count']:
+        samples = np.concatenate([np.arange(s, s + l) for s, l in
+                                  zip(header['roi_start'][:header['roi_count']], header['roi_length'][:header['roi_count']])])
+    else:
+        samples = np.arange(int(header['row_count']))
+
+    return header, lines, columns, samples
+
+
+RAW_ARCHIVE_HEADER = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('data_offset', '<u4'),
+    ('block_count', '<u8'),
+    ('block_size', '<u8'),
+    ('record_length', '<u8'),
+    ('segment_count', '<u4'),
+    ('channel_count', '<u2'),
+    ('reserved', '<u2'),
+    ('cycle_length', '<u8'),
+    ('fs', '<f8'),
+    ('type', '<u4', (8,)),
+    ('sample_size', '<u4', (8,)),
+    ('zero', '<i8', (8,)),
+    ('scale', '<f8', (8,)),
+])
+
+# numpy type of the libtiepie DATARAWTYPE_* codes:
+RAW_TYPES = {0x01: '<i1', 0x02: '<i2', 0x04: '<i4', 0x10: '<u1', 0x20: '<u2', 0x40: '<u4'}
+
+
+def read_raw_archive(filepath):
+    ''' returns the header of a _raw.bin archive and per channel the raw codes
+    of every block, shaped (blocks, segments, record length) and mapped from
+    the file. The volts are (codes - zero) * scale of the channel. '''
+
+    header = np.fromfile(filepath, dtype=RAW_ARCHIVE_HEADER, count=1)[0]
+    if header['magic'] != b'TPAVGRAW' or header['version'] != 1:
+        raise ValueError(f'{filepath} is not a raw archive')
+
+    block_count = int(header['block_count'])
+    shape = (int(header['segment_count']), int(header['record_length']))
+    blocks = np.memmap(filepath, dtype='u1', mode='r', offset=int(header['data_offset']),
+                       shape=(block_count, int(header['block_size'])))
+    channels = []
+    start = 0
+
+    # the channels of a block follow each other, blocks are block_size bytes apart:
+    for ch in range(int(header['channel_count'])):
+        size = shape[0] * shape[1] * int(header['sample_size'][ch])
+        codes = blocks[:, start:start + size]
+        channels.append(codes.view(RAW_TYPES[int(header['type'][ch])]).reshape((block_count,) + shape))
+        start += size
+
+    return header, channels
+
+
 class Signal():
     
     def __init__(self, filepath, name=False, color='k', debug=False):
@@ -23,10 +115,26 @@ class Signal():
         self.name = name if name else filepath
         self.color = color
         self.debug = debug
+
+        if filepath.endswith('.bin'):
+            self.process_binary()
+            return
+
         self.process_header()
         self.process_data()
 
 
+    def process_binary(self):
+
+        header, lines, columns, samples = read_binary(self.filepath)
+        if self.debug:
+            print(f'--- header of {self.filepath} ---')
+            for line in lines:
+                print(line)
+        self.xs = samples / header['fs'] # time points
+        self.ys = columns[0] # signal points
+
+
     def process_header(self):
         ''' returns the header length of the csv file. '''
 
@@ -132,8 +240,9 @@ plt.show()
 
 # b, a = signal.butter(1, 0.02)
 
+# snapshots of a single run with snapshotFirst = 1, snapshotRatio = 10:
 # for i in range(8):
-#     my_sig = Signal(f'noise_av10{i}.csv', debug=True)
+#     my_sig = Signal(f'./data/record_12_N{10**i}.csv', debug=True)
 #     fs = 200 # MHz
 #     ys = my_sig.ys
 #     xs = my_sig.xs